@@ -1,13 +1,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <zlib.h>
 #include <libpq-fe.h>
+#include <sqlite3.h>
 
+#ifndef MAX_ITEMS
 #define MAX_ITEMS 1000
+#endif
 #define MAX_NAME_LEN 64
 #define MAX_DESC_LEN 256
 #define MAX_UNIT_LEN 32
@@ -16,9 +36,64 @@
 #define DATA_FILE "equipment.dat"
 #define REQUEST_FILE "requests.dat"
 #define LOG_FILE "equipment.log"
+#define AUDIT_DIR "audit"
 #define DB_CONFIG_FILE "db_config.conf"
+#define SQLITE_DB_FILE "test_equipment_inventory.db"
+#define DEFAULT_SQLITE_MMAP_SIZE (256LL * 1024 * 1024)
 #define HASH_SIZE 1009
 #define MAX_QUERY_LEN 2048
+#define DEFAULT_FETCH_SIZE 256
+#define NOTIFY_BATCH_MAX 256
+#define DEFAULT_RESYNC_OVERLAP_SECONDS 2
+#define WRITE_BEHIND_MAX 256
+#define DEFAULT_WRITE_BEHIND_MS 500
+#define MAX_LOG_MSG_LEN 256
+#define DEFAULT_PAGE_SIZE 20
+#define DEFAULT_SEARCH_LIMIT 10
+#define SCHEMA_LOCK_KEY 7240001
+#define SCHEMA_VERSION_RESYNC 2
+#define SCHEMA_VERSION_NOTIFY 3
+#define ID_BLOCK_SIZE 64
+#define EVENT_TICK_MS 50
+#define INPUT_BUFFER_SIZE 512
+#define SLOW_QUERY_LOG "slow_queries.log"
+#define DEFAULT_QUERY_TIMEOUT_MS 5000
+#define DEFAULT_SLOW_QUERY_MS 200
+#define QUERY_CANCEL_GRACE_MS 1000
+#define MAX_QUERY_STATS 64
+#define QUERY_SAMPLES 512
+#define DEFAULT_MAX_REPLICA_LAG_MS 1000
+#define MAX_STARTUP_PHASES 8
+#define LOG_BUFFER_SIZE (64 * 1024)
+#define DEFAULT_LOG_FLUSH_MS 1000
+#define AUDIT_MAGIC "EQAUDIT1"
+#define AUDIT_MAGIC_LEN 8
+#define AUDIT_MAX_RECORD 512
+#define AUDIT_BLOCK_BYTES 4096
+#define AUDIT_BLOCK_ITEMS 128
+#define DEFAULT_AUDIT_SEGMENT_KB 4096
+#define DEFAULT_AUDIT_ROTATE_MINUTES 1440
+#define AUDIT_COMPRESSED_MAGIC "EQAUDZ01"
+#define AUDIT_PENDING_FDS 24
+#define AUDIT_ROLL_RETRY_US 1000000
+#define EVENT_RING_SLOTS 4096
+#define EVENT_RING_BATCH 256
+#define SNAPSHOT_DIR "snapshots"
+#define SNAPSHOT_MAGIC "EQSNAP01"
+#define DEFAULT_SNAPSHOT_MINUTES 60
+#define DEFAULT_SNAPSHOT_KEEP 48
+#define BACKUP_PATH "backups"
+#define BACKUP_MANIFEST_MAGIC "EQBACKUP1"
+#define CHUNK_MIN_BYTES 256
+#define CHUNK_AVG_BITS 10           // Boundary odds of 1 in 1 KB past the minimum
+#define CHUNK_MAX_BYTES 8192
+#define RESTORE_MAX_THREADS 8
+#define LOAD_MIN_SHARD 16384        // Records (about 7 MB) a load worker needs to be worth starting
+#define LOAD_MAX_THREADS 16
+#define LOAD_VERIFY 1               // Check each record against calculate_checksum()
+#define LOAD_INDEX 2                // Rebuild hash_table from the records
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
 
 // ANSI Color codes for military theming
 #define RESET   "\033[0m"
@@ -41,6 +116,40 @@ typedef struct {
     char dbname[64];
     char user[64];
     char password[128];
+    int fetch_size;         // Rows per FETCH when streaming large tables
+    int resync_interval;    // Seconds between automatic resyncs (0 = off)
+    int resync_overlap;     // Seconds re-read below the watermark
+    int write_behind;       // Coalesce quantity updates and flush in batches
+    int write_behind_ms;    // Maximum age of a pending batch
+    char storage_engine[16];        // memory, file or postgres
+    char data_file[128];            // File engine paths
+    char request_file[128];
+    char db_path[128];              // SQLite engine database file
+    long long sqlite_mmap_size;     // Bytes of the database mapped into memory
+    int sqlite_batch_size;          // Writes per transaction (1 = commit each edit)
+    int report_pushdown;            // Run reports as SQL instead of on the local copy
+    int page_size;                  // Rows per page when browsing in database mode
+    int search_limit;               // Top-N matches returned by database search
+    int query_timeout_ms;           // Per-statement deadline (0 = none)
+    int slow_query_ms;              // Log statements at least this slow (0 = off)
+    char slow_query_log[128];
+    char read_host[64];             // Streaming replica for heavy reads (empty = none)
+    char read_port[8];
+    int max_replica_lag_ms;         // Replay lag beyond which reads go to the primary
+    char log_file[128];             // Action log path
+    char log_fsync[16];             // none, interval or always
+    int log_ring;                   // Queue log and audit events for a writer thread
+    int log_flush_ms;               // Maximum age of buffered log lines
+    char audit_dir[128];            // Directory of binary audit log segments
+    int audit_segment_kb;           // Segment size before the log moves to a new file
+    int audit_rotate_minutes;       // Segment age before the log moves on (0 = size only)
+    int audit_compress;             // Compress closed segments in the background
+    int audit_retention_days;       // Delete segments older than this (0 = keep all)
+    char snapshot_dir[128];         // Point-in-time copies of the local state
+    int snapshot_minutes;           // Interval between snapshots (0 = off)
+    int snapshot_keep;              // Newest snapshots kept (0 = all)
+    char backup_path[128];          // Hot backups, one directory each
+    int load_threads;               // Workers for loads and restores (0 = one per core)
 } DBConfig;
 
 // Equipment item structure
@@ -68,6 +177,127 @@ typedef struct {
     int priority;
 } SupplyRequest;
 
+// One forward-only schema change, applied at most once per database
+typedef struct {
+    int version;
+    const char* description;
+    const char* sql;
+    const char* check;          // Returns true once the change took effect;
+                                // until then it is not recorded (NULL = always)
+} SchemaMigration;
+
+// Range of primary keys reserved from a table's sequence
+typedef struct {
+    const char* table;
+    const char* column;
+    int next;
+    int end;            // Exclusive; next == end means the block is used up
+} IdBlock;
+
+// Latest unflushed quantity for one item in write-behind mode
+typedef struct {
+    int id;
+    int quantity;
+    char checksum[16];
+} PendingUpdate;
+
+// Write-behind cache: updates coalesced per item ID plus the audit lines
+// that go out in the same transaction
+typedef struct {
+    PendingUpdate updates[WRITE_BEHIND_MAX];
+    int update_count;
+    char audit[WRITE_BEHIND_MAX][MAX_LOG_MSG_LEN];
+    int audit_count;
+    long long oldest_ms;
+    long flushes;
+} WriteBehindCache;
+
+// Per-engine operation counters
+typedef struct {
+    long inserts;
+    long updates;
+    long deletes;
+    long scans;
+    long flushes;
+    long long bytes_written;
+} StorageStats;
+
+// Item counts and quantities by classification and stock status
+typedef struct {
+    int items[4][3];
+    long long quantity[4][3];
+} InventorySummary;
+
+// Visitor for storage scans; return 0 to stop early
+typedef int (*EquipmentVisitor)(const Equipment* item, void* ctx);
+
+// Storage engine interface. inventory[] and requests[] are the working
+// set shared by every engine; an engine only persists changes to it.
+typedef struct {
+    const char* name;
+    const char* description;
+    int (*open)(void);
+    void (*load)(void);
+    int (*insert_equipment)(Equipment* item);   // May assign item->id
+    int (*update_equipment)(const Equipment* item);
+    int (*delete_equipment)(int id);
+    int (*insert_request)(SupplyRequest* req);  // May assign req->req_id
+    int (*scan_equipment)(EquipmentVisitor visit, void* ctx);
+    int (*flush)(void);
+    void (*stats)(StorageStats* out);
+    void (*close)(void);
+} StorageEngine;
+
+// Latency record for one statement label; keeps the newest QUERY_SAMPLES
+typedef struct {
+    char name[48];
+    long calls;
+    long slow;
+    long timeouts;
+    int samples[QUERY_SAMPLES];     // Microseconds
+    int sample_count;
+    int next_sample;
+} QueryStats;
+
+// Per-row callback for streamed result sets; return 0 to stop early
+typedef int (*RowHandler)(const PGresult* res, int row, void* ctx);
+
+// Time spent in one startup step
+typedef struct {
+    const char* name;
+    long long elapsed_us;
+} StartupPhase;
+
+// One table streamed in single-row mode during startup
+typedef struct {
+    const char* name;
+    PGconn* conn;
+    RowHandler handler;
+    int rows;
+    int done;
+    int failed;
+} StartupStream;
+
+// Multi-stage query job streamed on the background connection while the
+// operator keeps working. Each stage sends one query whose rows arrive in
+// single-row mode; send_stage returns 1 when a query went out, 0 when the
+// job has no stages left and -1 on error.
+typedef struct BackgroundJob {
+    char label[48];
+    int active;
+    int stage;
+    int failed;
+    int mutates_store;      // Rows patch inventory[]; only applied at the menu
+    int read_only;          // May run on the read replica
+    PGconn* conn;
+    int (*send_stage)(struct BackgroundJob* job);
+    RowHandler on_row;
+    void (*on_finish)(struct BackgroundJob* job, int ok);
+    void* ctx;
+    long rows;
+    long long started_ms;
+} BackgroundJob;
+
 // Hash table node for fast lookups
 typedef struct HashNode {
     Equipment* equipment;
@@ -75,6 +305,245 @@ typedef struct HashNode {
 } HashNode;
 
 // Enums for better code readability
+typedef enum {
+    LOG_INFO = 0,
+    LOG_WARNING = 1,
+    LOG_CRITICAL = 2
+} LogLevel;
+
+typedef enum {
+    FSYNC_NONE = 0,         // Leave write-back to the kernel
+    FSYNC_INTERVAL = 1,     // fsync on timed, level-triggered and shutdown flushes
+    FSYNC_ALWAYS = 2        // Write and fsync every line before returning
+} FsyncPolicy;
+
+// Append-only log kept open across calls. Lines collect in buffer and
+// reach the file when it fills, when flush_ms has passed, when a line at
+// or above flush_level arrives, or at shutdown.
+typedef struct {
+    int fd;
+    char buffer[LOG_BUFFER_SIZE];
+    size_t length;
+    long long last_flush_ms;
+    time_t stamp_second;    // Second the cached stamp was formatted for
+    char stamp[32];
+    FsyncPolicy fsync_policy;
+    int flush_ms;
+    LogLevel flush_level;
+    long lines;
+    long writes;
+    long fsyncs;
+} Logger;
+
+// Binary audit log record types. Each record is
+//   type:u8  delta_us:varint  length:varint  payload[length]
+// where delta_us is relative to the previous record and SESSION carries the
+// absolute time every later delta builds on. A SESSION opens every session
+// and every index block, so blocks decode independently. ADD and REQUEST
+// end with the rest of the row (after the "|") so replay can rebuild it;
+// readers that only want the summary fields stop before that tail. Rows
+// changed through the database by other stations are journaled too, ADD
+// and REQUEST then standing for a whole new version of the row.
+typedef enum {
+    AUDIT_SESSION = 0,      // start_us
+    AUDIT_ADD = 1,          // item_id, quantity, name_length, name |
+                            // min_threshold, classification, description, unit, location
+    AUDIT_UPDATE_QTY = 2,   // item_id, zigzag(old), zigzag(new)
+    AUDIT_REQUEST = 3,      // req_id, equipment_id, quantity, priority |
+                            // status, requesting_unit, request_time
+    AUDIT_EXPORT = 4,       // rows
+    AUDIT_SHUTDOWN = 5,
+    AUDIT_STARTUP = 6,      // startup_ms
+    AUDIT_DELETE_ITEM = 7,  // item_id
+    AUDIT_DELETE_REQUEST = 8,   // req_id, equipment_id
+    AUDIT_TYPE_COUNT
+} AuditType;
+
+// Payload under construction
+typedef struct {
+    uint8_t data[AUDIT_MAX_RECORD];
+    size_t length;
+} AuditRecord;
+
+// One decoded record; fields unused by a type stay zero
+typedef struct {
+    AuditType type;
+    long long timestamp_us;
+    long long id;               // Item ID, or request ID for REQUEST
+    long long item_id;          // Item the event concerns (0 = none)
+    long long values[3];
+    const char* name;
+    int name_length;
+    const uint8_t* tail;        // Row image after the summary fields
+    const uint8_t* tail_end;
+} AuditEvent;
+
+// Sparse time index (segment-N.tidx): one entry per block
+typedef struct {
+    int64_t first_us;           // Timestamp of the block's SESSION record
+    int64_t offset;             // Byte offset of the block in the segment
+} AuditTimeEntry;
+
+// Item index (segment-N.iidx): one entry the first time an item appears in
+// a block, so entries are ordered by block. A closed segment also gets a
+// copy sorted by item (segment-N.sidx).
+typedef struct {
+    uint32_t item_id;
+    uint32_t block;
+} AuditItemEntry;
+
+// Block index of a compressed segment (segment-N.zidx), parallel to .tidx.
+// Compressed segments keep .tidx for its timestamps and replace .audit
+// with .zaudit: the magic, then each block deflated on its own.
+typedef struct {
+    int64_t offset;             // Byte offset of the block in .zaudit
+    uint32_t length;
+    uint32_t raw_length;
+} AuditCompressedEntry;
+
+// Audit log split into numbered segments of about segment_limit bytes.
+// Each segment is cut into blocks of about AUDIT_BLOCK_BYTES that the two
+// sidecar indexes point into.
+typedef struct {
+    Logger data;
+    Logger time_index;
+    Logger item_index;
+    char dir[128];
+    int sequence;
+    long long segment_bytes;    // Size of the segment including buffered bytes
+    long long segment_limit;
+    long long segment_first_us; // Timestamp of the segment's first block
+    long long rotate_us;        // Segment age that forces a roll (0 = none)
+    long long block_start;      // Offset of the current block
+    uint32_t block;             // Index of the next block in the segment
+    int block_open;
+    uint32_t block_items[AUDIT_BLOCK_ITEMS];
+    int block_item_count;
+    long long clock_us;         // Timestamp of the last record written
+    long long roll_retry_us;    // Next segment could not be opened; retry after this (0 = none)
+} AuditLog;
+
+// Closed segments are fsynced, sealed, compressed and expired on a
+// background thread, so a roll only hands over file descriptors
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int running;
+    int stop;
+    int pending;                // Work queued since the last pass
+    int fds[AUDIT_PENDING_FDS]; // Closed segment files awaiting fsync and close
+    int fd_count;
+    int fsync;
+    char dir[128];
+    int active_sequence;        // Segment still being written; never touched
+    int compress;
+    long long retention_us;
+    long sealed;
+    long compressed;
+    long expired;
+} AuditCompressor;
+
+typedef enum {
+    RING_LOG_LINE = 0,
+    RING_AUDIT = 1
+} RingEventKind;
+
+// One queued event. The sequence says whose turn the slot is: it equals
+// the ring position while free and position + 1 once published.
+typedef struct {
+    _Alignas(64) _Atomic size_t sequence;
+    uint8_t kind;
+    uint8_t level;
+    uint8_t audit_type;
+    long long item_id;
+    long long timestamp_us;
+    union {
+        char text[MAX_LOG_MSG_LEN];
+        AuditRecord record;
+    };
+} RingSlot;
+
+// Bounded multi-producer, single-consumer queue in front of the loggers
+typedef struct {
+    RingSlot* slots;
+    size_t mask;
+    _Alignas(64) _Atomic size_t tail;   // Next position producers reserve
+    _Alignas(64) size_t head;           // Next position the writer consumes
+    _Atomic int sleeping;               // Writer is waiting on `wake`
+    _Atomic int stop;
+    _Atomic int running;
+    _Atomic long overflows;             // Events that found the ring full
+    long consumed;
+    long batches;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} EventRing;
+
+// Header of a snapshot file (snapshot-<taken_us>.snap). The inventory and
+// request arrays follow it as stored in memory; crc covers both.
+typedef struct {
+    char magic[8];
+    int64_t taken_us;           // Every audit event up to here is included
+    int32_t item_count;
+    int32_t next_item_id;
+    int32_t request_count;
+    int32_t next_request_id;
+    uint32_t item_size;         // sizeof(Equipment) when written
+    uint32_t request_size;
+    uint32_t crc;
+    uint32_t reserved;
+} SnapshotHeader;
+
+typedef enum {
+    COPY_SNAPSHOT,
+    COPY_BACKUP
+} CopyKind;
+
+// Child process writing a copy-on-write image of the arrays
+typedef struct {
+    pid_t pid;                  // 0 = none running
+    CopyKind kind;
+    long long started_us;
+    long long stall_us;         // Foreground cost of the last copy
+    char path[192];
+} ForkedCopy;
+
+// Writes the arrays as they are now to path
+typedef int (*ImageWriter)(const char* path, long long taken_us);
+
+// What one backup added to the chunk store
+typedef struct {
+    long chunks;
+    long new_chunks;
+    long long new_bytes;
+    long long total_bytes;      // Size of the data the backup covers
+} BackupStats;
+
+// Slice of the equipment records one load worker copies, verifies and
+// indexes
+typedef struct {
+    pthread_t thread;
+    int started;
+    const Equipment* source;    // NULL = already in inventory[]
+    int first;
+    int count;
+    int flags;
+    uLong crc;                  // CRC32 of the copied slice
+    int mismatches;             // Records whose stored checksum is wrong
+    int first_mismatch_id;
+    HashNode* heads[HASH_SIZE]; // The slice's part of each bucket
+    HashNode* tails[HASH_SIZE];
+} LoadShard;
+
+typedef struct {
+    uLong crc;
+    int mismatches;
+    int first_mismatch_id;
+    int threads;
+} LoadStats;
+
 typedef enum {
     STATUS_OK = 0,
     STATUS_WATCH = 1,
@@ -115,21 +584,89 @@ int next_request_id = 1;
 PGconn* db_conn = NULL;
 DBConfig db_config;
 int use_database = 0;
+const StorageEngine* storage = NULL;
+int schema_version = 0;
+int resync_supported = 0;
+int trigram_search = 0;
+PGconn* bg_conn = NULL;         // Lazily opened for background jobs
+PGconn* read_conn = NULL;       // Read replica, when configured
+int read_conn_busy = 0;         // A background job is streaming on read_conn
+int db_conn_busy = 0;           // A query is in flight on db_conn
+int ui_at_menu = 0;             // Waiting at the main menu, safe to patch the store
+BackgroundJob background_job;
+QueryStats query_stats[MAX_QUERY_STATS];
+int query_stats_count = 0;
+StartupPhase startup_phases[MAX_STARTUP_PHASES];
+int startup_phase_count = 0;
+long long startup_started_us = 0;
+long long startup_mark_us = 0;
+
+// Highest change timestamps (epoch seconds) merged from the database
+double equipment_watermark = 0;
+double request_watermark = 0;
+time_t last_resync = 0;
+time_t last_snapshot = 0;
+ForkedCopy forked_copy;
+WriteBehindCache write_behind;
+IdBlock equipment_id_block = {"equipment", "id", 0, 0};
+IdBlock request_id_block = {"supply_requests", "req_id", 0, 0};
+Logger action_logger = {.fd = -1};
+AuditLog audit_log = {.data = {.fd = -1}, .time_index = {.fd = -1}, .item_index = {.fd = -1}};
+AuditCompressor audit_compressor = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+EventRing event_ring = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
 
 // Lookup tables
 const char* CLASS_NAMES[] = {"UNCLASSIFIED", "RESTRICTED", "CONFIDENTIAL", "SECRET"};
 const char* STATUS_NAMES[] = {"PENDING", "APPROVED", "FULFILLED", "DENIED"};
 const char* PRIORITY_NAMES[] = {"", "LOW", "NORMAL", "HIGH", "CRITICAL"};
 const char* STOCK_STATUS_NAMES[] = {"OK", "WATCH", "LOW"};
+const char* AUDIT_TYPE_NAMES[] = {"SESSION", "ADD", "UPDATE_QTY", "REQUEST", "EXPORT",
+                                  "SHUTDOWN", "STARTUP", "DELETE_ITEM", "DELETE_REQUEST"};
 
 // Function prototypes
 void hash_insert(Equipment* equipment);
+void hash_remove(const Equipment* equipment);
+void hash_rebuild(void);
+void load_equipment_records(const Equipment* source, int count, int flags, int threads, LoadStats* stats);
+int calculate_checksum(const Equipment* item);
 Equipment* hash_find(const char* name);
 Equipment* find_by_id(int id);
+SupplyRequest* find_request_by_id(int req_id);
 void log_action(const char* action);
+void log_event(LogLevel level, const char* action);
+void audit_close(AuditLog* log);
+void audit_compressor_stop(void);
+int event_ring_log(LogLevel level, const char* message);
+int event_ring_audit(AuditType type, const AuditRecord* payload, long long item_id,
+                     long long timestamp_us, LogLevel level);
+void* event_ring_main(void* arg);
+void event_ring_stop(void);
+int take_snapshot(int background);
+int reap_forked_copy(int wait);
+void backup_inventory(void);
+int compare_ints(const void* a, const void* b);
+long long file_size(const char* path);
+int write_behind_flush(void);
+void write_behind_queue_audit(const char* action);
+void journal_add_equipment(const Equipment* item);
+void journal_update_quantity(const Equipment* item, int old_qty);
+void journal_request(const SupplyRequest* req);
+void journal_delete_equipment(int id);
+void journal_delete_request(const SupplyRequest* req);
+PGresult* execute_query(const char* query, int expected_result);
+long long now_ms(void);
+long long now_us(void);
+int migrate_schema(void);
+int subscribe_to_changes(void);
+int connect_read_replica(void);
+void apply_statement_timeout(PGconn* conn);
+void startup_phase(const char* name);
 void clear_screen(void);
 void display_banner(void);
 void wait_for_enter(void);
+int read_input_line(char* buffer, size_t buffer_size);
+int start_background_job(const BackgroundJob* spec);
+int send_background_query(const char* query);
 
 // ============================================================================
 // ENHANCED TERMINAL INTERFACE FUNCTIONS
@@ -149,12 +686,19 @@ void display_banner(void) {
     if (use_database) {
         printf("║  " CYAN "🗄️  DATABASE MODE" GREEN " - Real-time PostgreSQL Operations                    ║\n");
     } else {
-        printf("║  " YELLOW "📁 OFFLINE MODE" GREEN " - Local File Storage                                 ║\n");
+        printf("║  " YELLOW "📁 OFFLINE MODE" GREEN " - %-53s║\n", storage ? storage->description : "");
     }
     printf("║  System Status:  " GREEN "✅ OPERATIONAL" GREEN "                                              ║\n");
     printf("║  Access Level:   " YELLOW "🔒 AUTHORIZED PERSONNEL ONLY" GREEN "                             ║\n");
     printf("║  Equipment Count: " WHITE "%d items" GREEN " | Supply Requests: " WHITE "%d pending" GREEN "                   ║\n", 
            item_count, request_count);
+    if (background_job.active) {
+        char progress[128];
+        snprintf(progress, sizeof(progress), "%s: %ld rows, %llds",
+                 background_job.label, background_job.rows,
+                 (now_ms() - background_job.started_ms) / 1000);
+        printf("║  Background Job: " CYAN "⏳ %-58.58s" GREEN "║\n", progress);
+    }
     printf("╚══════════════════════════════════════════════════════════════════════════════╝" RESET "\n\n");
 }
 
@@ -169,8 +713,9 @@ void display_classification_banner(Classification level) {
 }
 
 void wait_for_enter(void) {
+    char discard[INPUT_BUFFER_SIZE];
     printf(BOLD CYAN "\n[Press ENTER to continue...]" RESET);
-    while (getchar() != '\n');
+    read_input_line(discard, sizeof(discard));
 }
 
 void display_command_prompt(void) {
@@ -182,12 +727,44 @@ void display_command_prompt(void) {
 // ============================================================================
 
 int load_db_config(void) {
+    db_config.fetch_size = DEFAULT_FETCH_SIZE;
+    db_config.resync_overlap = DEFAULT_RESYNC_OVERLAP_SECONDS;
+    db_config.write_behind_ms = DEFAULT_WRITE_BEHIND_MS;
+    db_config.page_size = DEFAULT_PAGE_SIZE;
+    db_config.search_limit = DEFAULT_SEARCH_LIMIT;
+    db_config.query_timeout_ms = DEFAULT_QUERY_TIMEOUT_MS;
+    db_config.slow_query_ms = DEFAULT_SLOW_QUERY_MS;
+    strcpy(db_config.slow_query_log, SLOW_QUERY_LOG);
+    db_config.max_replica_lag_ms = DEFAULT_MAX_REPLICA_LAG_MS;
+    strcpy(db_config.log_file, LOG_FILE);
+    strcpy(db_config.log_fsync, "interval");
+    db_config.log_flush_ms = DEFAULT_LOG_FLUSH_MS;
+    db_config.log_ring = 1;
+    strcpy(db_config.audit_dir, AUDIT_DIR);
+    db_config.audit_segment_kb = DEFAULT_AUDIT_SEGMENT_KB;
+    db_config.audit_rotate_minutes = DEFAULT_AUDIT_ROTATE_MINUTES;
+    db_config.audit_compress = 1;
+    strcpy(db_config.snapshot_dir, SNAPSHOT_DIR);
+    strcpy(db_config.backup_path, BACKUP_PATH);
+    db_config.snapshot_minutes = DEFAULT_SNAPSHOT_MINUTES;
+    db_config.snapshot_keep = DEFAULT_SNAPSHOT_KEEP;
+    strcpy(db_config.storage_engine, "file");
+    strcpy(db_config.data_file, DATA_FILE);
+    strcpy(db_config.request_file, REQUEST_FILE);
+    strcpy(db_config.db_path, SQLITE_DB_FILE);
+    db_config.sqlite_mmap_size = DEFAULT_SQLITE_MMAP_SIZE;
+    db_config.sqlite_batch_size = 1;
+    
     FILE* config = fopen(DB_CONFIG_FILE, "r");
     if (!config) {
         printf(YELLOW "⚠️  Warning: Database config file not found. Using offline mode.\n" RESET);
         return 0;
     }
     
+    // A config file without an explicit engine keeps the historical
+    // behaviour of trying PostgreSQL first
+    strcpy(db_config.storage_engine, "postgres");
+    
     char line[256];
     while (fgets(line, sizeof(line), config)) {
         line[strcspn(line, "\n")] = 0;
@@ -202,6 +779,78 @@ int load_db_config(void) {
             strncpy(db_config.user, line + 5, sizeof(db_config.user) - 1);
         } else if (strncmp(line, "password=", 9) == 0) {
             strncpy(db_config.password, line + 9, sizeof(db_config.password) - 1);
+        } else if (strncmp(line, "fetch_size=", 11) == 0) {
+            db_config.fetch_size = atoi(line + 11);
+            if (db_config.fetch_size < 1) db_config.fetch_size = DEFAULT_FETCH_SIZE;
+        } else if (strncmp(line, "resync_interval=", 16) == 0) {
+            db_config.resync_interval = atoi(line + 16);
+        } else if (strncmp(line, "resync_overlap=", 15) == 0) {
+            db_config.resync_overlap = atoi(line + 15);
+        } else if (strncmp(line, "write_behind=", 13) == 0) {
+            db_config.write_behind = atoi(line + 13);
+        } else if (strncmp(line, "write_behind_ms=", 16) == 0) {
+            db_config.write_behind_ms = atoi(line + 16);
+        } else if (strncmp(line, "storage_engine=", 15) == 0) {
+            strncpy(db_config.storage_engine, line + 15, sizeof(db_config.storage_engine) - 1);
+        } else if (strncmp(line, "data_file=", 10) == 0) {
+            strncpy(db_config.data_file, line + 10, sizeof(db_config.data_file) - 1);
+        } else if (strncmp(line, "request_file=", 13) == 0) {
+            strncpy(db_config.request_file, line + 13, sizeof(db_config.request_file) - 1);
+        } else if (strncmp(line, "db_path=", 8) == 0) {
+            strncpy(db_config.db_path, line + 8, sizeof(db_config.db_path) - 1);
+        } else if (strncmp(line, "sqlite_mmap_size=", 17) == 0) {
+            db_config.sqlite_mmap_size = atoll(line + 17);
+        } else if (strncmp(line, "sqlite_batch_size=", 18) == 0) {
+            db_config.sqlite_batch_size = atoi(line + 18);
+            if (db_config.sqlite_batch_size < 1) db_config.sqlite_batch_size = 1;
+        } else if (strncmp(line, "report_pushdown=", 16) == 0) {
+            db_config.report_pushdown = atoi(line + 16);
+        } else if (strncmp(line, "page_size=", 10) == 0) {
+            db_config.page_size = atoi(line + 10);
+            if (db_config.page_size < 1) db_config.page_size = DEFAULT_PAGE_SIZE;
+        } else if (strncmp(line, "search_limit=", 13) == 0) {
+            db_config.search_limit = atoi(line + 13);
+            if (db_config.search_limit < 1) db_config.search_limit = DEFAULT_SEARCH_LIMIT;
+        } else if (strncmp(line, "query_timeout_ms=", 17) == 0) {
+            db_config.query_timeout_ms = atoi(line + 17);
+        } else if (strncmp(line, "slow_query_ms=", 14) == 0) {
+            db_config.slow_query_ms = atoi(line + 14);
+        } else if (strncmp(line, "slow_query_log=", 15) == 0) {
+            strncpy(db_config.slow_query_log, line + 15, sizeof(db_config.slow_query_log) - 1);
+        } else if (strncmp(line, "read_host=", 10) == 0) {
+            strncpy(db_config.read_host, line + 10, sizeof(db_config.read_host) - 1);
+        } else if (strncmp(line, "read_port=", 10) == 0) {
+            strncpy(db_config.read_port, line + 10, sizeof(db_config.read_port) - 1);
+        } else if (strncmp(line, "max_replica_lag_ms=", 19) == 0) {
+            db_config.max_replica_lag_ms = atoi(line + 19);
+        } else if (strncmp(line, "log_file=", 9) == 0) {
+            strncpy(db_config.log_file, line + 9, sizeof(db_config.log_file) - 1);
+        } else if (strncmp(line, "log_fsync=", 10) == 0) {
+            strncpy(db_config.log_fsync, line + 10, sizeof(db_config.log_fsync) - 1);
+        } else if (strncmp(line, "log_flush_ms=", 13) == 0) {
+            db_config.log_flush_ms = atoi(line + 13);
+        } else if (strncmp(line, "log_ring=", 9) == 0) {
+            db_config.log_ring = atoi(line + 9);
+        } else if (strncmp(line, "audit_dir=", 10) == 0) {
+            strncpy(db_config.audit_dir, line + 10, sizeof(db_config.audit_dir) - 1);
+        } else if (strncmp(line, "audit_segment_kb=", 17) == 0) {
+            db_config.audit_segment_kb = atoi(line + 17);
+        } else if (strncmp(line, "audit_rotate_minutes=", 21) == 0) {
+            db_config.audit_rotate_minutes = atoi(line + 21);
+        } else if (strncmp(line, "audit_compress=", 15) == 0) {
+            db_config.audit_compress = atoi(line + 15);
+        } else if (strncmp(line, "audit_retention_days=", 21) == 0) {
+            db_config.audit_retention_days = atoi(line + 21);
+        } else if (strncmp(line, "snapshot_dir=", 13) == 0) {
+            strncpy(db_config.snapshot_dir, line + 13, sizeof(db_config.snapshot_dir) - 1);
+        } else if (strncmp(line, "snapshot_minutes=", 17) == 0) {
+            db_config.snapshot_minutes = atoi(line + 17);
+        } else if (strncmp(line, "snapshot_keep=", 14) == 0) {
+            db_config.snapshot_keep = atoi(line + 14);
+        } else if (strncmp(line, "backup_path=", 12) == 0) {
+            strncpy(db_config.backup_path, line + 12, sizeof(db_config.backup_path) - 1);
+        } else if (strncmp(line, "load_threads=", 13) == 0) {
+            db_config.load_threads = atoi(line + 13);
         }
     }
     
@@ -209,724 +858,7496 @@ int load_db_config(void) {
     return 1;
 }
 
-int connect_database(void) {
-    if (!load_db_config()) {
-        return 0;
+// A streaming replica shares the primary's databases and roles, so only
+// the endpoint differs
+void build_conninfo_for(char* conninfo, size_t size, const char* host, const char* port) {
+    snprintf(conninfo, size,
+             "host=%s port=%s dbname=%s user=%s password=%s",
+             host, port, db_config.dbname, db_config.user, db_config.password);
+}
+
+void build_conninfo(char* conninfo, size_t size) {
+    build_conninfo_for(conninfo, size, db_config.host, db_config.port);
+}
+
+// Drives several non-blocking connection attempts at once so their TCP
+// and authentication round trips overlap. Check PQstatus() afterwards.
+void connect_all(PGconn** conns, int count) {
+    PostgresPollingStatusType state[count];
+    int pending = 0;
+    for (int i = 0; i < count; i++) {
+        int started = conns[i] && PQstatus(conns[i]) != CONNECTION_BAD;
+        state[i] = started ? PGRES_POLLING_WRITING : PGRES_POLLING_FAILED;
+        pending += started;
     }
     
-    char conninfo[512];
-    snprintf(conninfo, sizeof(conninfo),
-             "host=%s port=%s dbname=%s user=%s password=%s",
-             db_config.host, db_config.port, db_config.dbname,
-             db_config.user, db_config.password);
+    while (pending > 0) {
+        struct pollfd fds[count];
+        for (int i = 0; i < count; i++) {
+            int waiting = state[i] == PGRES_POLLING_READING || state[i] == PGRES_POLLING_WRITING;
+            fds[i].fd = waiting ? PQsocket(conns[i]) : -1;
+            fds[i].events = state[i] == PGRES_POLLING_READING ? POLLIN : POLLOUT;
+            fds[i].revents = 0;
+        }
+        if (poll(fds, count, -1) < 0 && errno != EINTR) return;
+        
+        for (int i = 0; i < count; i++) {
+            if (fds[i].fd < 0 || !fds[i].revents) continue;
+            state[i] = PQconnectPoll(conns[i]);
+            if (state[i] == PGRES_POLLING_OK || state[i] == PGRES_POLLING_FAILED) pending--;
+        }
+    }
+}
+
+// Opens the primary, the background connection and the read replica in
+// parallel. Only the primary is required; the others degrade gracefully.
+int connect_database(void) {
+    char conninfo[512], replica_conninfo[512];
+    build_conninfo(conninfo, sizeof(conninfo));
+    build_conninfo_for(replica_conninfo, sizeof(replica_conninfo), db_config.read_host,
+                       db_config.read_port[0] ? db_config.read_port : db_config.port);
     
-    db_conn = PQconnectdb(conninfo);
+    db_conn = PQconnectStart(conninfo);
+    bg_conn = PQconnectStart(conninfo);
+    read_conn = db_config.read_host[0] ? PQconnectStart(replica_conninfo) : NULL;
+    PGconn* conns[3] = {db_conn, bg_conn, read_conn};
+    connect_all(conns, 3);
+    startup_phase("connect");
     
     if (PQstatus(db_conn) != CONNECTION_OK) {
         printf(YELLOW "⚠️  Warning: Database connection failed: %s\n" RESET, PQerrorMessage(db_conn));
         printf(CYAN "🔄 Falling back to file-based storage for offline operation.\n" RESET);
         PQfinish(db_conn);
-        db_conn = NULL;
+        PQfinish(bg_conn);
+        PQfinish(read_conn);
+        db_conn = bg_conn = read_conn = NULL;
         return 0;
     }
+    if (PQstatus(bg_conn) != CONNECTION_OK) {
+        // Reopened on demand by the first background job
+        PQfinish(bg_conn);
+        bg_conn = NULL;
+    }
     
     printf(GREEN "✅ Connected to PostgreSQL database successfully.\n" RESET);
-    return 1;
-}
-
-PGresult* execute_query(const char* query, int expected_result) {
-    if (!db_conn) return NULL;
     
-    PGresult* res = PQexec(db_conn, query);
-    ExecStatusType status = PQresultStatus(res);
+    apply_statement_timeout(db_conn);
+    if (bg_conn) apply_statement_timeout(bg_conn);
     
-    if (status != expected_result) {
-        printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(db_conn));
-        PQclear(res);
-        return NULL;
+    if (!migrate_schema()) {
+        printf(YELLOW "⚠️  Warning: Schema migration failed; continuing with schema version %d.\n" RESET,
+               schema_version);
     }
+    startup_phase("schema");
     
-    return res;
+    resync_supported = schema_version >= SCHEMA_VERSION_RESYNC;
+    
+    PGresult* res = execute_query("SELECT 1 FROM pg_extension WHERE extname = 'pg_trgm'",
+                                  PGRES_TUPLES_OK);
+    if (res) {
+        trigram_search = PQntuples(res) > 0;
+        PQclear(res);
+    }
+    if (schema_version < SCHEMA_VERSION_NOTIFY || !subscribe_to_changes()) {
+        printf(YELLOW "⚠️  Warning: Change notifications unavailable; other stations' edits will not sync.\n" RESET);
+    }
+    if (read_conn) connect_read_replica();
+    return 1;
 }
 
-void load_equipment_from_db(void) {
-    const char* query = "SELECT id, name, description, quantity, min_threshold, "
-                       "unit, location, classification, checksum, "
-                       "EXTRACT(EPOCH FROM last_updated) FROM equipment ORDER BY id";
+// Returns the text after keyword when it appears outside parentheses, so
+// "EXTRACT(EPOCH FROM x) FROM t" resolves to t
+const char* find_top_level_keyword(const char* query, const char* keyword) {
+    size_t length = strlen(keyword);
+    int depth = 0;
+    for (const char* p = query; *p; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')') depth--;
+        else if (depth == 0 && strncasecmp(p, keyword, length) == 0) return p + length;
+    }
+    return NULL;
+}
+
+// Groups statements that differ only in their literals: the verb plus the
+// table or cursor it targets, e.g. "SELECT equipment" or "FETCH load_cur"
+void statement_label(const char* query, char* label, size_t size) {
+    while (isspace((unsigned char)*query)) query++;
+    int verb = (int)strcspn(query, " \t\n;(");
     
-    PGresult* res = execute_query(query, PGRES_TUPLES_OK);
-    if (!res) return;
+    const char* target;
+    if (strncasecmp(query, "INSERT", 6) == 0) {
+        target = find_top_level_keyword(query, " INTO ");
+    } else if (strncasecmp(query, "UPDATE", 6) == 0 || strncasecmp(query, "DECLARE", 7) == 0 ||
+               strncasecmp(query, "CLOSE", 5) == 0) {
+        target = query + verb;
+    } else {
+        target = find_top_level_keyword(query, " FROM ");
+    }
     
-    item_count = PQntuples(res);
-    if (item_count > MAX_ITEMS) {
-        printf(YELLOW "⚠️  Warning: Database contains more items than maximum. Truncating to %d.\n" RESET, MAX_ITEMS);
-        item_count = MAX_ITEMS;
+    int target_length = 0;
+    if (target) {
+        while (isspace((unsigned char)*target)) target++;
+        while (isalnum((unsigned char)target[target_length]) || target[target_length] == '_' ||
+               target[target_length] == '.') {
+            target_length++;
+        }
     }
+    snprintf(label, size, "%.*s%s%.*s", verb, query, target_length ? " " : "",
+             target_length, target_length ? target : "");
+    for (char* p = label; *p && *p != ' '; p++) *p = toupper((unsigned char)*p);
+}
+
+QueryStats* find_query_stats(const char* label) {
+    for (int i = 0; i < query_stats_count; i++) {
+        if (strcmp(query_stats[i].name, label) == 0) return &query_stats[i];
+    }
+    if (query_stats_count == MAX_QUERY_STATS) return NULL;
     
-    for (int i = 0; i < item_count; i++) {
-        Equipment* item = &inventory[i];
-        
-        item->id = atoi(PQgetvalue(res, i, 0));
-        strncpy(item->name, PQgetvalue(res, i, 1), MAX_NAME_LEN - 1);
-        strncpy(item->description, PQgetvalue(res, i, 2), MAX_DESC_LEN - 1);
-        item->quantity = atoi(PQgetvalue(res, i, 3));
-        item->min_threshold = atoi(PQgetvalue(res, i, 4));
-        strncpy(item->unit, PQgetvalue(res, i, 5), MAX_UNIT_LEN - 1);
-        strncpy(item->location, PQgetvalue(res, i, 6), MAX_LOCATION_LEN - 1);
-        item->classification = atoi(PQgetvalue(res, i, 7));
-        strncpy(item->checksum, PQgetvalue(res, i, 8), 15);
-        item->last_updated = (time_t)atol(PQgetvalue(res, i, 9));
-        
-        hash_insert(item);
-        
-        if (item->id >= next_item_id) {
-            next_item_id = item->id + 1;
+    QueryStats* stats = &query_stats[query_stats_count++];
+    memset(stats, 0, sizeof(QueryStats));
+    strncpy(stats->name, label, sizeof(stats->name) - 1);
+    return stats;
+}
+
+void log_slow_query(const char* label, const char* query, long long elapsed_us,
+                    const PGresult* res) {
+    long rows = 0;
+    long long bytes = 0;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+        rows = PQntuples(res);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < PQnfields(res); c++) bytes += PQgetlength(res, r, c);
         }
+    } else if (res) {
+        rows = atol(PQcmdTuples((PGresult*)res));
     }
     
-    PQclear(res);
-    printf(GREEN "📊 Loaded %d equipment items from database.\n" RESET, item_count);
+    FILE* log = fopen(db_config.slow_query_log, "a");
+    if (!log) return;
+    
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(log, "[%s] %s latency_ms=%.3f rows=%ld bytes=%lld status=%s query=%.200s\n",
+            stamp, label, elapsed_us / 1000.0, rows, bytes,
+            res ? PQresStatus(PQresultStatus(res)) : "NO_RESULT", query);
+    fclose(log);
 }
 
-void load_requests_from_db(void) {
-    const char* query = "SELECT req_id, equipment_id, requested_qty, requesting_unit, "
-                       "EXTRACT(EPOCH FROM request_time), status, priority "
-                       "FROM supply_requests ORDER BY req_id";
+// Adds one execution to the per-statement latency stats and the slow log
+void record_query(PGconn* conn, const char* query, long long started_us, const PGresult* res) {
+    long long elapsed_us = now_us() - started_us;
+    char label[48];
+    statement_label(query, label, sizeof(label));
+    if (conn == read_conn) {
+        size_t length = strlen(label);
+        snprintf(label + length, sizeof(label) - length, " @replica");
+    }
     
-    PGresult* res = execute_query(query, PGRES_TUPLES_OK);
-    if (!res) return;
+    QueryStats* stats = find_query_stats(label);
+    if (stats) {
+        stats->calls++;
+        stats->samples[stats->next_sample] = elapsed_us > 0x7fffffff ? 0x7fffffff : (int)elapsed_us;
+        stats->next_sample = (stats->next_sample + 1) % QUERY_SAMPLES;
+        if (stats->sample_count < QUERY_SAMPLES) stats->sample_count++;
+        
+        const char* sqlstate = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+        if (sqlstate && strcmp(sqlstate, "57014") == 0) stats->timeouts++;
+    }
     
-    request_count = PQntuples(res);
-    if (request_count > MAX_REQUESTS) {
-        printf(YELLOW "⚠️  Warning: Database contains more requests than maximum. Truncating to %d.\n" RESET, MAX_REQUESTS);
-        request_count = MAX_REQUESTS;
+    if (db_config.slow_query_ms > 0 && elapsed_us >= db_config.slow_query_ms * 1000LL) {
+        if (stats) stats->slow++;
+        log_slow_query(label, query, elapsed_us, res);
     }
+}
+
+// Waits for the query in flight on conn without blocking in libpq: the
+// socket is polled and input consumed until the result is complete.
+// The caller still waits, so foreground statements hold the menu until
+// they finish or hit deadline_ms; only resyncs and exports run as
+// background jobs.
+// Like PQexec, the last result is returned unless an earlier one failed.
+// Past deadline_ms (0 = none) the query is cancelled and its error result
+// returned.
+PGresult* await_result_until(PGconn* conn, long long deadline_ms) {
+    PGresult* last = NULL;
     
-    for (int i = 0; i < request_count; i++) {
-        SupplyRequest* req = &requests[i];
+    while (1) {
+        while (PQisBusy(conn)) {
+            int timeout = -1;
+            if (deadline_ms) {
+                long long remaining = deadline_ms - now_ms();
+                timeout = remaining > 0 ? (int)remaining : 0;
+            }
+            
+            struct pollfd pfd = {PQsocket(conn), POLLIN, 0};
+            int ready = poll(&pfd, 1, timeout);
+            if (ready < 0 && errno != EINTR) break;
+            
+            if (ready == 0 && deadline_ms) {
+                char errbuf[256];
+                PGcancel* cancel = PQgetCancel(conn);
+                if (cancel) {
+                    PQcancel(cancel, errbuf, sizeof(errbuf));
+                    PQfreeCancel(cancel);
+                }
+                printf(YELLOW "⚠️  Query deadline exceeded; cancelling.\n" RESET);
+                deadline_ms = 0;
+                continue;
+            }
+            if (!PQconsumeInput(conn)) break;
+        }
         
-        req->req_id = atoi(PQgetvalue(res, i, 0));
-        req->equipment_id = atoi(PQgetvalue(res, i, 1));
-        req->requested_qty = atoi(PQgetvalue(res, i, 2));
-        strncpy(req->requesting_unit, PQgetvalue(res, i, 3), MAX_UNIT_LEN - 1);
-        req->request_time = (time_t)atol(PQgetvalue(res, i, 4));
-        req->status = atoi(PQgetvalue(res, i, 5));
-        req->priority = atoi(PQgetvalue(res, i, 6));
+        PGresult* res = PQgetResult(conn);
+        if (!res) break;
         
-        if (req->req_id >= next_request_id) {
-            next_request_id = req->req_id + 1;
+        if (last && PQresultStatus(last) == PGRES_FATAL_ERROR) {
+            PQclear(res);
+        } else {
+            PQclear(last);
+            last = res;
         }
+        if (PQstatus(conn) == CONNECTION_BAD) break;
     }
-    
-    PQclear(res);
-    printf(GREEN "📋 Loaded %d supply requests from database.\n" RESET, request_count);
+    return last;
 }
 
-int add_equipment_to_db(const Equipment* item) {
-    if (!db_conn) return 0;
-    
-    char query[MAX_QUERY_LEN];
-    snprintf(query, sizeof(query),
-             "INSERT INTO equipment (name, description, quantity, min_threshold, "
-             "unit, location, classification, checksum) VALUES "
-             "('%s', '%s', %d, %d, '%s', '%s', %d, '%s') RETURNING id",
-             item->name, item->description, item->quantity, item->min_threshold,
-             item->unit, item->location, item->classification, item->checksum);
-    
-    PGresult* res = execute_query(query, PGRES_TUPLES_OK);
-    if (!res) return 0;
-    
-    int new_id = atoi(PQgetvalue(res, 0, 0));
-    PQclear(res);
-    
-    return new_id;
+PGresult* await_result(PGconn* conn) {
+    return await_result_until(conn, 0);
 }
 
-int update_equipment_in_db(const Equipment* item) {
-    if (!db_conn) return 0;
-    
-    char query[MAX_QUERY_LEN];
-    snprintf(query, sizeof(query),
-             "UPDATE equipment SET quantity=%d, checksum='%s', "
-             "last_updated=CURRENT_TIMESTAMP WHERE id=%d",
-             item->quantity, item->checksum, item->id);
-    
-    PGresult* res = execute_query(query, PGRES_COMMAND_OK);
-    if (!res) return 0;
-    
-    PQclear(res);
-    return 1;
+long long query_deadline(int timeout_ms) {
+    return timeout_ms > 0 ? now_ms() + timeout_ms + QUERY_CANCEL_GRACE_MS : 0;
 }
 
-int add_request_to_db(const SupplyRequest* req) {
-    if (!db_conn) return 0;
-    
-    char query[MAX_QUERY_LEN];
-    snprintf(query, sizeof(query),
-             "INSERT INTO supply_requests (equipment_id, requested_qty, "
-             "requesting_unit, status, priority) VALUES "
-             "(%d, %d, '%s', %d, %d) RETURNING req_id",
-             req->equipment_id, req->requested_qty, req->requesting_unit,
-             req->status, req->priority);
+// Runs a cleanup statement (ROLLBACK, CLOSE) whose outcome is not checked
+void discard_query_on(PGconn* conn, const char* query) {
+    if (PQsendQuery(conn, query)) PQclear(await_result(conn));
+}
+
+void discard_query(const char* query) {
+    discard_query_on(db_conn, query);
+}
+
+// timeout_ms = 0 waits indefinitely, e.g. for schema migrations queued
+// behind another station's lock
+PGresult* execute_query_on(PGconn* conn, const char* query, int expected_result, int timeout_ms) {
+    if (!conn) return NULL;
     
-    PGresult* res = execute_query(query, PGRES_TUPLES_OK);
-    if (!res) return 0;
+    long long started = now_us();
+    PGresult* res = PQsendQuery(conn, query)
+                    ? await_result_until(conn, query_deadline(timeout_ms)) : NULL;
+    record_query(conn, query, started, res);
+    ExecStatusType status = PQresultStatus(res);
     
-    int new_id = atoi(PQgetvalue(res, 0, 0));
-    PQclear(res);
+    if (status != (ExecStatusType)expected_result) {
+        printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(conn));
+        PQclear(res);
+        return NULL;
+    }
     
-    return new_id;
+    return res;
 }
 
-void log_to_database(const char* action) {
-    if (!db_conn) return;
-    
-    char query[MAX_QUERY_LEN];
-    snprintf(query, sizeof(query),
-             "INSERT INTO audit_log (action, user_info) VALUES ('%s', 'system')",
-             action);
-    
-    PGresult* res = execute_query(query, PGRES_COMMAND_OK);
-    if (res) PQclear(res);
+// The server enforces the deadline; the client only cancels if the
+// server has not answered shortly after it should have
+void apply_statement_timeout(PGconn* conn) {
+    if (db_config.query_timeout_ms <= 0) return;
+    char timeout[64];
+    snprintf(timeout, sizeof(timeout), "SET statement_timeout = %d", db_config.query_timeout_ms);
+    PQclear(execute_query_on(conn, timeout, PGRES_COMMAND_OK, 0));
 }
 
-// ============================================================================
-// UTILITY FUNCTIONS
-// ============================================================================
+// Streams that read a whole table in single-row mode are one statement
+// however long the table, so they lift the deadline for themselves only
+void format_untimed_read(char* out, size_t size, const char* select_sql) {
+    snprintf(out, size, "BEGIN; SET LOCAL statement_timeout = 0; %s; COMMIT", select_sql);
+}
 
-unsigned int hash_function(const char* str) {
-    unsigned int hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c;
-    }
-    return hash % HASH_SIZE;
+// A failed untimed read skips its COMMIT and leaves the connection in an
+// aborted transaction
+void end_untimed_read(PGconn* conn) {
+    if (!conn) return;
+    PGTransactionStatusType status = PQtransactionStatus(conn);
+    if (status == PQTRANS_INERROR || status == PQTRANS_INTRANS) discard_query_on(conn, "ROLLBACK");
 }
 
-void hash_insert(Equipment* equipment) {
-    unsigned int index = hash_function(equipment->name);
-    HashNode* new_node = malloc(sizeof(HashNode));
-    new_node->equipment = equipment;
-    new_node->next = hash_table[index];
-    hash_table[index] = new_node;
+PGresult* execute_query_within(const char* query, int expected_result, int timeout_ms) {
+    return execute_query_on(db_conn, query, expected_result, timeout_ms);
 }
 
-Equipment* hash_find(const char* name) {
-    unsigned int index = hash_function(name);
-    HashNode* current = hash_table[index];
+PGresult* execute_query(const char* query, int expected_result) {
+    return execute_query_within(query, expected_result, db_config.query_timeout_ms);
+}
+
+PGresult* execute_params_query_on(PGconn* conn, const char* query, int nparams,
+                                  const char* const* values, int expected_result) {
+    if (!conn) return NULL;
     
-    while (current) {
-        if (strcasestr(current->equipment->name, name)) {
-            return current->equipment;
-        }
-        current = current->next;
+    long long started = now_us();
+    PGresult* res = PQsendQueryParams(conn, query, nparams, NULL, values, NULL, NULL, 0)
+                    ? await_result_until(conn, query_deadline(db_config.query_timeout_ms))
+                    : NULL;
+    record_query(conn, query, started, res);
+    ExecStatusType status = PQresultStatus(res);
+    
+    if (status != (ExecStatusType)expected_result) {
+        printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(conn));
+        PQclear(res);
+        return NULL;
     }
-    return NULL;
+    
+    return res;
 }
 
-Equipment* find_by_id(int id) {
-    for (int i = 0; i < item_count; i++) {
-        if (inventory[i].id == id) {
-            return &inventory[i];
-        }
-    }
-    return NULL;
+PGresult* execute_params_query(const char* query, int nparams,
+                               const char* const* values, int expected_result) {
+    return execute_params_query_on(db_conn, query, nparams, values, expected_result);
 }
 
-StockStatus get_stock_status(const Equipment* item) {
-    if (item->quantity <= item->min_threshold) {
-        return STATUS_LOW;
-    } else if (item->quantity <= (int)(item->min_threshold * 1.5)) {
-        return STATUS_WATCH;
-    }
-    return STATUS_OK;
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-void get_string_input(const char* prompt, char* buffer, size_t buffer_size) {
-    printf(CYAN "%s" RESET, prompt);
-    if (fgets(buffer, buffer_size, stdin)) {
-        buffer[strcspn(buffer, "\n")] = 0;
-    }
+long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-int get_int_input(const char* prompt, int min_val, int max_val) {
-    int value;
-    do {
-        printf(CYAN "%s" RESET, prompt);
-        if (scanf("%d", &value) != 1) {
-            printf(RED "❌ Invalid input. Please enter a number.\n" RESET);
-            while (getchar() != '\n');
-            continue;
-        }
-        while (getchar() != '\n');
+long get_peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+// Streams a SELECT through a server-side cursor so that at most
+// fetch_size rows are held client-side at any time. Returns the number of
+// rows handed to the handler, or -1 if the query failed.
+int stream_query_on(PGconn* conn, const char* cursor_name, const char* select_sql,
+                    RowHandler handler, void* ctx) {
+    if (!conn) return -1;
+    
+    int own_txn = PQtransactionStatus(conn) == PQTRANS_IDLE;
+    if (own_txn) {
+        PGresult* res = execute_query_on(conn, "BEGIN", PGRES_COMMAND_OK, db_config.query_timeout_ms);
+        if (!res) return -1;
+        PQclear(res);
+    }
+    
+    char query[MAX_QUERY_LEN];
+    snprintf(query, sizeof(query), "DECLARE %s NO SCROLL CURSOR FOR %s",
+             cursor_name, select_sql);
+    PGresult* res = execute_query_on(conn, query, PGRES_COMMAND_OK, db_config.query_timeout_ms);
+    if (!res) {
+        if (own_txn) discard_query_on(conn, "ROLLBACK");
+        return -1;
+    }
+    PQclear(res);
+    
+    char fetch[128];
+    snprintf(fetch, sizeof(fetch), "FETCH FORWARD %d FROM %s",
+             db_config.fetch_size > 0 ? db_config.fetch_size : DEFAULT_FETCH_SIZE,
+             cursor_name);
+    
+    int handled = 0;
+    int more = 1;
+    while (more) {
+        res = execute_query_on(conn, fetch, PGRES_TUPLES_OK, db_config.query_timeout_ms);
+        if (!res) {
+            if (own_txn) discard_query_on(conn, "ROLLBACK");
+            return -1;
+        }
+        
+        int rows = PQntuples(res);
+        if (rows == 0) more = 0;
+        for (int i = 0; i < rows && more; i++) {
+            handled++;
+            if (!handler(res, i, ctx)) more = 0;
+        }
+        PQclear(res);
+    }
+    
+    snprintf(query, sizeof(query), "CLOSE %s", cursor_name);
+    discard_query_on(conn, query);
+    if (own_txn) discard_query_on(conn, "COMMIT");
+    
+    return handled;
+}
+
+int stream_query(const char* cursor_name, const char* select_sql,
+                 RowHandler handler, void* ctx) {
+    return stream_query_on(db_conn, cursor_name, select_sql, handler, ctx);
+}
+
+// --- Read routing: heavy reads go to a streaming replica when it is fresh ---
+
+// Finishes setting up the replica connection started by connect_database()
+int connect_read_replica(void) {
+    if (PQstatus(read_conn) != CONNECTION_OK) {
+        printf(YELLOW "⚠️  Warning: Read replica connection failed: %s" RESET, PQerrorMessage(read_conn));
+        printf(CYAN "🔄 Reads will use the primary.\n" RESET);
+        PQfinish(read_conn);
+        read_conn = NULL;
+        return 0;
+    }
+    
+    apply_statement_timeout(read_conn);
+    printf(GREEN "✅ Connected to read replica at %s.\n" RESET, db_config.read_host);
+    return 1;
+}
+
+void drop_read_replica(const char* reason) {
+    printf(YELLOW "⚠️  Warning: %s; reads will use the primary.\n" RESET, reason);
+    PQfinish(read_conn);
+    read_conn = NULL;
+    read_conn_busy = 0;
+}
+
+// Fresh means the replica has replayed everything the primary had written
+// when asked, which gives read-your-writes, or that its replay lag is
+// within max_replica_lag_ms
+int replica_is_fresh(void) {
+    // Buffered local writes have not reached the primary yet
+    write_behind_flush();
+    
+    PGresult* res = execute_query("SELECT pg_current_wal_lsn()", PGRES_TUPLES_OK);
+    if (!res) return 0;
+    char primary_lsn[32];
+    strncpy(primary_lsn, PQgetvalue(res, 0, 0), sizeof(primary_lsn) - 1);
+    primary_lsn[sizeof(primary_lsn) - 1] = 0;
+    PQclear(res);
+    
+    const char* params[1] = {primary_lsn};
+    res = execute_params_query_on(read_conn,
+        "SELECT pg_is_in_recovery(), "
+        "COALESCE(pg_last_wal_replay_lsn() >= $1::pg_lsn, false), "
+        "COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000, 0)",
+        1, params, PGRES_TUPLES_OK);
+    if (!res) {
+        if (PQstatus(read_conn) == CONNECTION_BAD) drop_read_replica("Read replica connection lost");
+        return 0;
+    }
+    
+    int in_recovery = PQgetvalue(res, 0, 0)[0] == 't';
+    int caught_up = PQgetvalue(res, 0, 1)[0] == 't';
+    double lag_ms = atof(PQgetvalue(res, 0, 2));
+    PQclear(res);
+    
+    if (!in_recovery) {
+        drop_read_replica("Read endpoint is not a standby");
+        return 0;
+    }
+    return caught_up || lag_ms <= db_config.max_replica_lag_ms;
+}
+
+// Connection for a heavy read: the replica when it is idle and fresh,
+// otherwise the primary
+PGconn* read_connection(void) {
+    if (!read_conn || read_conn_busy) return db_conn;
+    if (PQstatus(read_conn) == CONNECTION_BAD) {
+        drop_read_replica("Read replica connection lost");
+        return db_conn;
+    }
+    return replica_is_fresh() ? read_conn : db_conn;
+}
+
+PGresult* execute_read_query(const char* query, int expected_result) {
+    PGconn* conn = read_connection();
+    PGresult* res = execute_query_on(conn, query, expected_result, db_config.query_timeout_ms);
+    if (!res && conn == read_conn && conn != db_conn) {
+        if (PQstatus(read_conn) == CONNECTION_BAD) drop_read_replica("Read replica connection lost");
+        res = execute_query(query, expected_result);
+    }
+    return res;
+}
+
+typedef struct {
+    RowHandler handler;
+    void* ctx;
+    int rows;
+} RoutedStream;
+
+static int routed_row(const PGresult* res, int row, void* ctx) {
+    RoutedStream* routed = ctx;
+    routed->rows++;
+    return routed->handler(res, row, routed->ctx);
+}
+
+// Streams from the replica when possible. A replica failure before any row
+// was delivered is retried on the primary; after that the caller sees it.
+int stream_read_query(const char* cursor_name, const char* select_sql,
+                      RowHandler handler, void* ctx) {
+    PGconn* conn = read_connection();
+    RoutedStream routed = {handler, ctx, 0};
+    int handled = stream_query_on(conn, cursor_name, select_sql, routed_row, &routed);
+    
+    if (handled < 0 && conn == read_conn && conn != db_conn && routed.rows == 0) {
+        if (PQstatus(read_conn) == CONNECTION_BAD) drop_read_replica("Read replica connection lost");
+        handled = stream_query(cursor_name, select_sql, handler, ctx);
+    }
+    return handled;
+}
+
+void equipment_from_row(Equipment* item, const PGresult* res, int row) {
+    item->id = atoi(PQgetvalue(res, row, 0));
+    strncpy(item->name, PQgetvalue(res, row, 1), MAX_NAME_LEN - 1);
+    strncpy(item->description, PQgetvalue(res, row, 2), MAX_DESC_LEN - 1);
+    item->quantity = atoi(PQgetvalue(res, row, 3));
+    item->min_threshold = atoi(PQgetvalue(res, row, 4));
+    strncpy(item->unit, PQgetvalue(res, row, 5), MAX_UNIT_LEN - 1);
+    strncpy(item->location, PQgetvalue(res, row, 6), MAX_LOCATION_LEN - 1);
+    item->classification = atoi(PQgetvalue(res, row, 7));
+    strncpy(item->checksum, PQgetvalue(res, row, 8), 15);
+    item->last_updated = (time_t)atol(PQgetvalue(res, row, 9));
+}
+
+void request_from_row(SupplyRequest* req, const PGresult* res, int row) {
+    req->req_id = atoi(PQgetvalue(res, row, 0));
+    req->equipment_id = atoi(PQgetvalue(res, row, 1));
+    req->requested_qty = atoi(PQgetvalue(res, row, 2));
+    strncpy(req->requesting_unit, PQgetvalue(res, row, 3), MAX_UNIT_LEN - 1);
+    req->request_time = (time_t)atol(PQgetvalue(res, row, 4));
+    req->status = atoi(PQgetvalue(res, row, 5));
+    req->priority = atoi(PQgetvalue(res, row, 6));
+}
+
+int load_equipment_row(const PGresult* res, int row, void* ctx) {
+    (void)ctx;
+    if (item_count >= MAX_ITEMS) return 0;
+    
+    Equipment* item = &inventory[item_count++];
+    equipment_from_row(item, res, row);
+    hash_insert(item);
+    
+    if (item->id >= next_item_id) {
+        next_item_id = item->id + 1;
+    }
+    
+    double changed_at = atof(PQgetvalue(res, row, 9));
+    if (changed_at > equipment_watermark) equipment_watermark = changed_at;
+    return 1;
+}
+
+// The request load may still be streaming at the menu, where change
+// notifications are applied. A request they already brought in is newer
+// than this row from the load's snapshot, so it is kept.
+int load_request_row(const PGresult* res, int row, void* ctx) {
+    (void)ctx;
+    SupplyRequest fresh = {0};
+    request_from_row(&fresh, res, row);
+    if (!find_request_by_id(fresh.req_id)) {
+        if (request_count >= MAX_REQUESTS) return 0;
+        requests[request_count++] = fresh;
+    }
+    
+    if (fresh.req_id >= next_request_id) {
+        next_request_id = fresh.req_id + 1;
+    }
+    
+    double changed_at = atof(PQgetvalue(res, row, 7));
+    if (changed_at > request_watermark) request_watermark = changed_at;
+    return 1;
+}
+
+// One row past capacity is enough to tell that the table was truncated
+void format_equipment_load_query(char* query, size_t size) {
+    snprintf(query, size,
+             "SELECT id, name, description, quantity, min_threshold, "
+             "unit, location, classification, checksum, "
+             "EXTRACT(EPOCH FROM last_updated) FROM equipment ORDER BY id LIMIT %d",
+             MAX_ITEMS + 1);
+}
+
+void format_request_load_query(char* query, size_t size) {
+    snprintf(query, size,
+             "SELECT req_id, equipment_id, requested_qty, requesting_unit, "
+             "EXTRACT(EPOCH FROM request_time), status, priority, %s "
+             "FROM supply_requests ORDER BY req_id LIMIT %d",
+             resync_supported ? "EXTRACT(EPOCH FROM updated_at)" : "0", MAX_REQUESTS + 1);
+}
+
+void load_equipment_from_db(void) {
+    char query[MAX_QUERY_LEN];
+    format_equipment_load_query(query, sizeof(query));
+    
+    long rss_before = get_peak_rss_kb();
+    
+    item_count = 0;
+    int rows = stream_read_query("equipment_load_cur", query, load_equipment_row, NULL);
+    if (rows < 0) return;
+    
+    // The handler stops at the row that no longer fits
+    if (item_count >= MAX_ITEMS && rows > item_count) {
+        printf(YELLOW "⚠️  Warning: Database contains more items than maximum. Truncating to %d.\n" RESET, MAX_ITEMS);
+    }
+    
+    long rss_after = get_peak_rss_kb();
+    printf(GREEN "📊 Loaded %d equipment items from database.\n" RESET, item_count);
+    printf(CYAN "📈 Load memory: peak RSS %ld KB (+%ld KB during load, fetch size %d)\n" RESET,
+           rss_after, rss_after - rss_before, db_config.fetch_size);
+}
+
+void load_requests_from_db(void) {
+    char query[MAX_QUERY_LEN];
+    format_request_load_query(query, sizeof(query));
+    
+    request_count = 0;
+    int rows = stream_read_query("requests_load_cur", query, load_request_row, NULL);
+    if (rows < 0) return;
+    
+    if (request_count >= MAX_REQUESTS && rows > request_count) {
+        printf(YELLOW "⚠️  Warning: Database contains more requests than maximum. Truncating to %d.\n" RESET, MAX_REQUESTS);
+    }
+    
+    printf(GREEN "📋 Loaded %d supply requests from database.\n" RESET, request_count);
+}
+
+// One nextval() on a sequence whose increment is the block size reserves
+// the whole range [value, value + increment) for this client, so IDs can
+// be assigned locally and stay unique across every tracker instance.
+int reserve_id_block(IdBlock* block) {
+    const char* params[2] = {block->table, block->column};
+    PGresult* res = execute_params_query(
+        "SELECT nextval(q.seq), s.seqincrement "
+        "FROM (SELECT pg_get_serial_sequence($1, $2)::regclass AS seq) AS q "
+        "JOIN pg_sequence s ON s.seqrelid = q.seq",
+        2, params, PGRES_TUPLES_OK);
+    if (!res) return 0;
+    
+    if (PQntuples(res) != 1) {
+        PQclear(res);
+        return 0;
+    }
+    block->next = atoi(PQgetvalue(res, 0, 0));
+    block->end = block->next + atoi(PQgetvalue(res, 0, 1));
+    PQclear(res);
+    return 1;
+}
+
+// Returns the next reserved ID, or 0 if no block could be reserved
+int allocate_id(IdBlock* block) {
+    if (block->next >= block->end && !reserve_id_block(block)) return 0;
+    return block->next++;
+}
+
+int add_equipment_to_db(const Equipment* item) {
+    if (!db_conn) return 0;
+    
+    char id[16], quantity[16], min_threshold[16], classification[16];
+    int new_id = allocate_id(&equipment_id_block);
+    snprintf(id, sizeof(id), "%d", new_id);
+    snprintf(quantity, sizeof(quantity), "%d", item->quantity);
+    snprintf(min_threshold, sizeof(min_threshold), "%d", item->min_threshold);
+    snprintf(classification, sizeof(classification), "%d", item->classification);
+    const char* params[9] = {
+        item->name, item->description, quantity, min_threshold,
+        item->unit, item->location, classification, item->checksum, id
+    };
+    
+    // Without a reserved ID, fall back to letting the sequence assign one
+    if (!new_id) {
+        PGresult* res = execute_params_query(
+            "INSERT INTO equipment (name, description, quantity, min_threshold, "
+            "unit, location, classification, checksum) VALUES "
+            "($1, $2, $3, $4, $5, $6, $7, $8) RETURNING id",
+            8, params, PGRES_TUPLES_OK);
+        if (!res) return 0;
+        
+        new_id = atoi(PQgetvalue(res, 0, 0));
+        PQclear(res);
+        return new_id;
+    }
+    
+    PGresult* res = execute_params_query(
+        "INSERT INTO equipment (name, description, quantity, min_threshold, "
+        "unit, location, classification, checksum, id) VALUES "
+        "($1, $2, $3, $4, $5, $6, $7, $8, $9)",
+        9, params, PGRES_COMMAND_OK);
+    if (!res) return 0;
+    
+    PQclear(res);
+    return new_id;
+}
+
+int delete_equipment_from_db(int id) {
+    if (!db_conn) return 0;
+    
+    char id_text[16];
+    snprintf(id_text, sizeof(id_text), "%d", id);
+    const char* params[1] = {id_text};
+    
+    PGresult* res = execute_params_query("DELETE FROM equipment WHERE id = $1",
+                                         1, params, PGRES_COMMAND_OK);
+    if (!res) return 0;
+    
+    PQclear(res);
+    return 1;
+}
+
+int update_equipment_in_db(const Equipment* item) {
+    if (!db_conn) return 0;
+    
+    char query[MAX_QUERY_LEN];
+    snprintf(query, sizeof(query),
+             "UPDATE equipment SET quantity=%d, checksum='%s', "
+             "last_updated=CURRENT_TIMESTAMP WHERE id=%d",
+             item->quantity, item->checksum, item->id);
+    
+    PGresult* res = execute_query(query, PGRES_COMMAND_OK);
+    if (!res) return 0;
+    
+    PQclear(res);
+    return 1;
+}
+
+int add_request_to_db(const SupplyRequest* req) {
+    if (!db_conn) return 0;
+    
+    char req_id[16], equipment_id[16], requested_qty[16], status[16], priority[16];
+    int new_id = allocate_id(&request_id_block);
+    snprintf(req_id, sizeof(req_id), "%d", new_id);
+    snprintf(equipment_id, sizeof(equipment_id), "%d", req->equipment_id);
+    snprintf(requested_qty, sizeof(requested_qty), "%d", req->requested_qty);
+    snprintf(status, sizeof(status), "%d", req->status);
+    snprintf(priority, sizeof(priority), "%d", req->priority);
+    const char* params[6] = {
+        equipment_id, requested_qty, req->requesting_unit, status, priority, req_id
+    };
+    
+    if (!new_id) {
+        PGresult* res = execute_params_query(
+            "INSERT INTO supply_requests (equipment_id, requested_qty, "
+            "requesting_unit, status, priority) VALUES "
+            "($1, $2, $3, $4, $5) RETURNING req_id",
+            5, params, PGRES_TUPLES_OK);
+        if (!res) return 0;
+        
+        new_id = atoi(PQgetvalue(res, 0, 0));
+        PQclear(res);
+        return new_id;
+    }
+    
+    PGresult* res = execute_params_query(
+        "INSERT INTO supply_requests (equipment_id, requested_qty, "
+        "requesting_unit, status, priority, req_id) VALUES "
+        "($1, $2, $3, $4, $5, $6)",
+        6, params, PGRES_COMMAND_OK);
+    if (!res) return 0;
+    
+    PQclear(res);
+    return new_id;
+}
+
+// Inserts one audit_log row right away. Returns 0 if the insert failed.
+int insert_audit_row(const char* action) {
+    char query[MAX_QUERY_LEN];
+    snprintf(query, sizeof(query),
+             "INSERT INTO audit_log (action, user_info) VALUES ('%s', 'system')",
+             action);
+    
+    PGresult* res = execute_query(query, PGRES_COMMAND_OK);
+    if (!res) return 0;
+    PQclear(res);
+    return 1;
+}
+
+void log_to_database(const char* action) {
+    if (!db_conn) return;
+    
+    if (db_config.write_behind) {
+        write_behind_queue_audit(action);
+        return;
+    }
+    
+    insert_audit_row(action);
+}
+
+// ============================================================================
+// SCHEMA MIGRATIONS
+// ============================================================================
+
+// Append-only: never edit a migration once released, add a new one instead
+static const SchemaMigration SCHEMA_MIGRATIONS[] = {
+    {1, "base tables",
+     "CREATE TABLE IF NOT EXISTS equipment ("
+     "  id SERIAL PRIMARY KEY,"
+     "  name VARCHAR(63) NOT NULL,"
+     "  description VARCHAR(255) NOT NULL DEFAULT '',"
+     "  quantity INTEGER NOT NULL DEFAULT 0 CHECK (quantity >= 0),"
+     "  min_threshold INTEGER NOT NULL DEFAULT 0 CHECK (min_threshold >= 0),"
+     "  unit VARCHAR(31) NOT NULL DEFAULT 'ea',"
+     "  location VARCHAR(63) NOT NULL DEFAULT '',"
+     "  classification SMALLINT NOT NULL DEFAULT 0 CHECK (classification BETWEEN 0 AND 3),"
+     "  checksum VARCHAR(15) NOT NULL DEFAULT '',"
+     "  last_updated TIMESTAMPTZ NOT NULL DEFAULT now()); "
+     "CREATE TABLE IF NOT EXISTS supply_requests ("
+     "  req_id SERIAL PRIMARY KEY,"
+     "  equipment_id INTEGER NOT NULL REFERENCES equipment(id) ON DELETE CASCADE,"
+     "  requested_qty INTEGER NOT NULL CHECK (requested_qty > 0),"
+     "  requesting_unit VARCHAR(31) NOT NULL,"
+     "  request_time TIMESTAMPTZ NOT NULL DEFAULT now(),"
+     "  status SMALLINT NOT NULL DEFAULT 0 CHECK (status BETWEEN 0 AND 3),"
+     "  priority SMALLINT NOT NULL DEFAULT 2 CHECK (priority BETWEEN 1 AND 4)); "
+     "CREATE TABLE IF NOT EXISTS audit_log ("
+     "  id BIGSERIAL PRIMARY KEY,"
+     "  action TEXT NOT NULL,"
+     "  user_info VARCHAR(64) NOT NULL DEFAULT 'system',"
+     "  logged_at TIMESTAMPTZ NOT NULL DEFAULT now());",
+     NULL},
+    
+    // Requests get an updated_at column and both tables bump their change
+    // timestamp on every UPDATE, whoever the writer is, so they can be
+    // resynced by watermark.
+    {SCHEMA_VERSION_RESYNC, "change timestamps",
+     "ALTER TABLE supply_requests "
+     "  ADD COLUMN IF NOT EXISTS updated_at TIMESTAMPTZ NOT NULL DEFAULT now(); "
+     "CREATE OR REPLACE FUNCTION touch_request_updated_at() RETURNS trigger AS $$ "
+     "BEGIN NEW.updated_at := now(); RETURN NEW; END $$ LANGUAGE plpgsql; "
+     "CREATE OR REPLACE FUNCTION touch_equipment_last_updated() RETURNS trigger AS $$ "
+     "BEGIN NEW.last_updated := now(); RETURN NEW; END $$ LANGUAGE plpgsql; "
+     "DROP TRIGGER IF EXISTS supply_requests_touch ON supply_requests; "
+     "CREATE TRIGGER supply_requests_touch BEFORE UPDATE ON supply_requests "
+     "  FOR EACH ROW EXECUTE PROCEDURE touch_request_updated_at(); "
+     "DROP TRIGGER IF EXISTS equipment_touch ON equipment; "
+     "CREATE TRIGGER equipment_touch BEFORE UPDATE ON equipment "
+     "  FOR EACH ROW EXECUTE PROCEDURE touch_equipment_last_updated();",
+     NULL},
+    
+    // Row-level triggers publish the primary key of every changed row so
+    // that each tracker instance can re-fetch just those rows.
+    {SCHEMA_VERSION_NOTIFY, "change notification triggers",
+     "CREATE OR REPLACE FUNCTION notify_equipment_change() RETURNS trigger AS $$ "
+     "BEGIN "
+     "  PERFORM pg_notify('equipment_changed', "
+     "    (CASE WHEN TG_OP = 'DELETE' THEN OLD.id ELSE NEW.id END)::text); "
+     "  RETURN NULL; "
+     "END $$ LANGUAGE plpgsql; "
+     "CREATE OR REPLACE FUNCTION notify_request_change() RETURNS trigger AS $$ "
+     "BEGIN "
+     "  PERFORM pg_notify('supply_requests_changed', "
+     "    (CASE WHEN TG_OP = 'DELETE' THEN OLD.req_id ELSE NEW.req_id END)::text); "
+     "  RETURN NULL; "
+     "END $$ LANGUAGE plpgsql; "
+     "DROP TRIGGER IF EXISTS equipment_notify ON equipment; "
+     "CREATE TRIGGER equipment_notify AFTER INSERT OR UPDATE OR DELETE ON equipment "
+     "  FOR EACH ROW EXECUTE PROCEDURE notify_equipment_change(); "
+     "DROP TRIGGER IF EXISTS supply_requests_notify ON supply_requests; "
+     "CREATE TRIGGER supply_requests_notify AFTER INSERT OR UPDATE OR DELETE ON supply_requests "
+     "  FOR EACH ROW EXECUTE PROCEDURE notify_request_change();",
+     NULL},
+    
+    // pg_trgm needs CREATE privilege on the database; without it the name
+    // index is skipped and searches fall back to a scan.
+    {4, "performance indexes",
+     "DO $$ BEGIN "
+     "  CREATE EXTENSION IF NOT EXISTS pg_trgm; "
+     "EXCEPTION WHEN OTHERS THEN "
+     "  RAISE WARNING 'pg_trgm unavailable: %', SQLERRM; "
+     "END $$; "
+     "DO $$ BEGIN "
+     "  IF EXISTS (SELECT 1 FROM pg_extension WHERE extname = 'pg_trgm') THEN "
+     "    CREATE INDEX IF NOT EXISTS equipment_name_trgm_idx "
+     "      ON equipment USING gin (name gin_trgm_ops); "
+     "  END IF; "
+     "END $$; "
+     "CREATE INDEX IF NOT EXISTS equipment_location_idx ON equipment (location); "
+     "CREATE INDEX IF NOT EXISTS equipment_stock_margin_idx "
+     "  ON equipment ((quantity - min_threshold)); "
+     "CREATE INDEX IF NOT EXISTS equipment_last_updated_idx ON equipment (last_updated); "
+     "CREATE INDEX IF NOT EXISTS supply_requests_queue_idx "
+     "  ON supply_requests (status, priority, request_time); "
+     "CREATE INDEX IF NOT EXISTS supply_requests_updated_at_idx "
+     "  ON supply_requests (updated_at);",
+     NULL},
+    
+    // Each nextval() hands a client a block of ID_BLOCK_SIZE keys. Plain
+    // DEFAULT inserts from other tools still get unique (if sparse) IDs.
+    {5, "block ID allocation",
+     "DO $$ BEGIN "
+     "  EXECUTE format('ALTER SEQUENCE %s INCREMENT BY " TOSTRING(ID_BLOCK_SIZE) "', "
+     "    pg_get_serial_sequence('equipment', 'id')); "
+     "  EXECUTE format('ALTER SEQUENCE %s INCREMENT BY " TOSTRING(ID_BLOCK_SIZE) "', "
+     "    pg_get_serial_sequence('supply_requests', 'req_id')); "
+     "END $$;",
+     NULL},
+    
+    // Migration 4 skips the name index when pg_trgm cannot be created.
+    // This one is retried on every connect until the index exists.
+    {6, "trigram name index",
+     "DO $$ BEGIN "
+     "  CREATE EXTENSION IF NOT EXISTS pg_trgm; "
+     "EXCEPTION WHEN OTHERS THEN "
+     "  RAISE WARNING 'pg_trgm unavailable: %', SQLERRM; "
+     "END $$; "
+     "DO $$ BEGIN "
+     "  IF EXISTS (SELECT 1 FROM pg_extension WHERE extname = 'pg_trgm') THEN "
+     "    CREATE INDEX IF NOT EXISTS equipment_name_trgm_idx "
+     "      ON equipment USING gin (name gin_trgm_ops); "
+     "  END IF; "
+     "END $$;",
+     "SELECT to_regclass('equipment_name_trgm_idx') IS NOT NULL"},
+};
+
+#define SCHEMA_MIGRATION_COUNT (int)(sizeof(SCHEMA_MIGRATIONS) / sizeof(SCHEMA_MIGRATIONS[0]))
+
+// Brings the database up to the latest schema version in one transaction.
+// An advisory lock serializes tracker instances starting at the same time.
+// It is taken in a statement of its own, before schema_version is touched:
+// under READ COMMITTED each later statement then sees what an instance
+// that held the lock first committed.
+int migrate_schema(void) {
+    const char* setup =
+        "BEGIN; "
+        "SET LOCAL client_min_messages = warning; "
+        "SET LOCAL statement_timeout = 0;";
+    PGresult* res = execute_query(setup, PGRES_COMMAND_OK);
+    if (!res) {
+        discard_query("ROLLBACK");
+        return 0;
+    }
+    PQclear(res);
+    
+    char query[MAX_QUERY_LEN];
+    snprintf(query, sizeof(query), "SELECT pg_advisory_xact_lock(%d)", SCHEMA_LOCK_KEY);
+    res = execute_query_within(query, PGRES_TUPLES_OK, 0);
+    if (res) {
+        PQclear(res);
+        res = execute_query("CREATE TABLE IF NOT EXISTS schema_version ("
+                            "  version INTEGER PRIMARY KEY,"
+                            "  description TEXT NOT NULL,"
+                            "  applied_at TIMESTAMPTZ NOT NULL DEFAULT now())",
+                            PGRES_COMMAND_OK);
+    }
+    if (res) {
+        PQclear(res);
+        res = execute_query("SELECT version FROM schema_version", PGRES_TUPLES_OK);
+    }
+    if (!res) {
+        discard_query("ROLLBACK");
+        return 0;
+    }
+    
+    // Versions are checked one by one rather than against the highest,
+    // since a migration whose check fails stays unrecorded behind later ones
+    int recorded[SCHEMA_MIGRATION_COUNT] = {0};
+    int current = 0;
+    for (int row = 0; row < PQntuples(res); row++) {
+        int version = atoi(PQgetvalue(res, row, 0));
+        if (version > current) current = version;
+        for (int i = 0; i < SCHEMA_MIGRATION_COUNT; i++) {
+            if (SCHEMA_MIGRATIONS[i].version == version) recorded[i] = 1;
+        }
+    }
+    PQclear(res);
+    
+    int applied = 0, latest = current;
+    for (int i = 0; i < SCHEMA_MIGRATION_COUNT; i++) {
+        const SchemaMigration* migration = &SCHEMA_MIGRATIONS[i];
+        if (recorded[i]) continue;
+        
+        res = execute_query_within(migration->sql, PGRES_COMMAND_OK, 0);
+        if (!res) {
+            printf(RED "❌ Schema migration %d (%s) failed.\n" RESET,
+                   migration->version, migration->description);
+            discard_query("ROLLBACK");
+            schema_version = current;
+            return 0;
+        }
+        PQclear(res);
+        
+        if (migration->check) {
+            res = execute_query_within(migration->check, PGRES_TUPLES_OK, 0);
+            int done = res && strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+            if (res) PQclear(res);
+            if (!done) {
+                printf(YELLOW "⚠️  Schema migration %d (%s) did not take effect; retrying at next connect.\n" RESET,
+                       migration->version, migration->description);
+                continue;
+            }
+        }
+        
+        char version[16];
+        snprintf(version, sizeof(version), "%d", migration->version);
+        const char* params[2] = {version, migration->description};
+        res = execute_params_query(
+            "INSERT INTO schema_version (version, description) VALUES ($1, $2)",
+            2, params, PGRES_COMMAND_OK);
+        if (!res) {
+            discard_query("ROLLBACK");
+            schema_version = current;
+            return 0;
+        }
+        PQclear(res);
+        applied++;
+        if (migration->version > latest) latest = migration->version;
+    }
+    
+    res = execute_query("COMMIT", PGRES_COMMAND_OK);
+    if (!res) {
+        schema_version = current;
+        return 0;
+    }
+    PQclear(res);
+    
+    schema_version = latest;
+    if (applied) {
+        printf(GREEN "🗄️  Applied %d schema migration(s); schema now at version %d.\n" RESET,
+               applied, schema_version);
+    }
+    return 1;
+}
+
+// ============================================================================
+// CHANGE NOTIFICATIONS (LISTEN/NOTIFY)
+// ============================================================================
+
+int subscribe_to_changes(void) {
+    PGresult* res = execute_query("LISTEN equipment_changed; LISTEN supply_requests_changed",
+                                  PGRES_COMMAND_OK);
+    if (!res) return 0;
+    PQclear(res);
+    return 1;
+}
+
+// Appends an ID to a batch unless it is already queued
+static void id_list_add(int* ids, int* count, int max, int id) {
+    for (int i = 0; i < *count; i++) {
+        if (ids[i] == id) return;
+    }
+    if (*count < max) ids[(*count)++] = id;
+}
+
+// Renders IDs as a Postgres array literal ("{1,2,3}")
+static void format_id_array(char* buffer, size_t size, const int* ids, int count) {
+    size_t len = snprintf(buffer, size, "{");
+    for (int i = 0; i < count && len < size; i++) {
+        len += snprintf(buffer + len, size - len, "%s%d", i ? "," : "", ids[i]);
+    }
+    if (len < size) snprintf(buffer + len, size - len, "}");
+}
+
+// Fields replay rebuilds; checksum and last_updated are derived
+int equipment_row_differs(const Equipment* a, const Equipment* b) {
+    return a->min_threshold != b->min_threshold || a->classification != b->classification ||
+           strcmp(a->name, b->name) != 0 || strcmp(a->description, b->description) != 0 ||
+           strcmp(a->unit, b->unit) != 0 || strcmp(a->location, b->location) != 0;
+}
+
+int request_row_differs(const SupplyRequest* a, const SupplyRequest* b) {
+    return a->equipment_id != b->equipment_id || a->requested_qty != b->requested_qty ||
+           a->status != b->status || a->priority != b->priority ||
+           a->request_time != b->request_time || strcmp(a->requesting_unit, b->requesting_unit) != 0;
+}
+
+// Notification and resync changes are journaled like local ones, so the
+// audit log can rebuild this station's view of the database. Rows re-read
+// without a change (the resync overlap) add nothing.
+void upsert_equipment(const Equipment* src) {
+    Equipment* item = find_by_id(src->id);
+    if (item && equipment_row_differs(item, src)) {
+        journal_add_equipment(src);
+    } else if (item && item->quantity != src->quantity) {
+        journal_update_quantity(src, item->quantity);
+    } else if (!item && item_count < MAX_ITEMS) {
+        journal_add_equipment(src);
+    }
+    
+    if (item) {
+        hash_remove(item);
+        *item = *src;
+        hash_insert(item);
+    } else if (item_count < MAX_ITEMS) {
+        item = &inventory[item_count++];
+        *item = *src;
+        hash_insert(item);
+    }
+    
+    if (src->id >= next_item_id) {
+        next_item_id = src->id + 1;
+    }
+}
+
+// Removal shifts the array to preserve listing order, so the caller must
+// run hash_rebuild() once the whole batch has been applied.
+int remove_equipment(int id) {
+    Equipment* item = find_by_id(id);
+    if (!item) return 0;
+    
+    journal_delete_equipment(id);
+    int index = (int)(item - inventory);
+    memmove(&inventory[index], &inventory[index + 1],
+            (item_count - index - 1) * sizeof(Equipment));
+    item_count--;
+    return 1;
+}
+
+void upsert_request(const SupplyRequest* src) {
+    SupplyRequest* req = find_request_by_id(src->req_id);
+    if (req ? request_row_differs(req, src) : request_count < MAX_REQUESTS) {
+        journal_request(src);
+    }
+    
+    if (req) {
+        *req = *src;
+    } else if (request_count < MAX_REQUESTS) {
+        requests[request_count++] = *src;
+    }
+    
+    if (src->req_id >= next_request_id) {
+        next_request_id = src->req_id + 1;
+    }
+}
+
+void remove_request(int req_id) {
+    SupplyRequest* req = find_request_by_id(req_id);
+    if (!req) return;
+    
+    journal_delete_request(req);
+    int index = (int)(req - requests);
+    memmove(&requests[index], &requests[index + 1],
+            (request_count - index - 1) * sizeof(SupplyRequest));
+    request_count--;
+}
+
+void refresh_equipment_rows(const int* ids, int count) {
+    // Pending local quantities must land first or the refresh would revert them
+    write_behind_flush();
+    
+    char id_array[NOTIFY_BATCH_MAX * 12 + 2];
+    format_id_array(id_array, sizeof(id_array), ids, count);
+    const char* params[1] = {id_array};
+    
+    PGresult* res = execute_params_query(
+        "SELECT id, name, description, quantity, min_threshold, "
+        "unit, location, classification, checksum, "
+        "EXTRACT(EPOCH FROM last_updated) FROM equipment WHERE id = ANY($1::int[])",
+        1, params, PGRES_TUPLES_OK);
+    if (!res) return;
+    
+    int found[NOTIFY_BATCH_MAX] = {0};
+    for (int r = 0; r < PQntuples(res); r++) {
+        Equipment fresh = {0};
+        equipment_from_row(&fresh, res, r);
+        upsert_equipment(&fresh);
+        for (int i = 0; i < count; i++) {
+            if (ids[i] == fresh.id) found[i] = 1;
+        }
+    }
+    PQclear(res);
+    
+    // Rows that no longer come back were deleted by another station
+    int removed = 0;
+    for (int i = 0; i < count; i++) {
+        if (!found[i]) removed += remove_equipment(ids[i]);
+    }
+    if (removed) hash_rebuild();
+}
+
+void refresh_request_rows(const int* ids, int count) {
+    char id_array[NOTIFY_BATCH_MAX * 12 + 2];
+    format_id_array(id_array, sizeof(id_array), ids, count);
+    const char* params[1] = {id_array};
+    
+    PGresult* res = execute_params_query(
+        "SELECT req_id, equipment_id, requested_qty, requesting_unit, "
+        "EXTRACT(EPOCH FROM request_time), status, priority "
+        "FROM supply_requests WHERE req_id = ANY($1::int[])",
+        1, params, PGRES_TUPLES_OK);
+    if (!res) return;
+    
+    int found[NOTIFY_BATCH_MAX] = {0};
+    for (int r = 0; r < PQntuples(res); r++) {
+        SupplyRequest fresh = {0};
+        request_from_row(&fresh, res, r);
+        upsert_request(&fresh);
+        for (int i = 0; i < count; i++) {
+            if (ids[i] == fresh.req_id) found[i] = 1;
+        }
+    }
+    PQclear(res);
+    
+    for (int i = 0; i < count; i++) {
+        if (!found[i]) remove_request(ids[i]);
+    }
+}
+
+// Drains pending notifications and patches only the rows they name.
+// Notifications raised by our own session are skipped since those edits
+// are already applied locally. Returns the number of rows refreshed.
+int process_change_notifications(void) {
+    if (!db_conn) return 0;
+    if (!PQconsumeInput(db_conn)) return 0;
+    
+    int equipment_ids[NOTIFY_BATCH_MAX], request_ids[NOTIFY_BATCH_MAX];
+    int equipment_changes = 0, request_changes = 0;
+    int own_pid = PQbackendPID(db_conn);
+    int total = 0;
+    
+    PGnotify* notify;
+    while ((notify = PQnotifies(db_conn)) != NULL) {
+        if (notify->be_pid != own_pid) {
+            int id = atoi(notify->extra);
+            if (strcmp(notify->relname, "equipment_changed") == 0) {
+                id_list_add(equipment_ids, &equipment_changes, NOTIFY_BATCH_MAX, id);
+            } else if (strcmp(notify->relname, "supply_requests_changed") == 0) {
+                id_list_add(request_ids, &request_changes, NOTIFY_BATCH_MAX, id);
+            }
+        }
+        PQfreemem(notify);
+        
+        if (equipment_changes == NOTIFY_BATCH_MAX) {
+            refresh_equipment_rows(equipment_ids, equipment_changes);
+            total += equipment_changes;
+            equipment_changes = 0;
+        }
+        if (request_changes == NOTIFY_BATCH_MAX) {
+            refresh_request_rows(request_ids, request_changes);
+            total += request_changes;
+            request_changes = 0;
+        }
+    }
+    
+    if (equipment_changes) refresh_equipment_rows(equipment_ids, equipment_changes);
+    if (request_changes) refresh_request_rows(request_ids, request_changes);
+    
+    return total + equipment_changes + request_changes;
+}
+
+// ============================================================================
+// UTILITY FUNCTIONS
+// ============================================================================
+
+unsigned int hash_function(const char* str) {
+    unsigned int hash = 5381;
+    int c;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+    return hash % HASH_SIZE;
+}
+
+void hash_insert(Equipment* equipment) {
+    unsigned int index = hash_function(equipment->name);
+    HashNode* new_node = malloc(sizeof(HashNode));
+    new_node->equipment = equipment;
+    new_node->next = hash_table[index];
+    hash_table[index] = new_node;
+}
+
+void hash_remove(const Equipment* equipment) {
+    unsigned int index = hash_function(equipment->name);
+    HashNode** link = &hash_table[index];
+    
+    while (*link) {
+        if ((*link)->equipment == equipment) {
+            HashNode* temp = *link;
+            *link = temp->next;
+            free(temp);
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+void hash_clear(void) {
+    for (int i = 0; i < HASH_SIZE; i++) {
+        HashNode* current = hash_table[i];
+        while (current) {
+            HashNode* temp = current;
+            current = current->next;
+            free(temp);
+        }
+        hash_table[i] = NULL;
+    }
+}
+
+void hash_rebuild(void) {
+    load_equipment_records(NULL, item_count, LOAD_INDEX, 0, NULL);
+}
+
+Equipment* hash_find(const char* name) {
+    unsigned int index = hash_function(name);
+    HashNode* current = hash_table[index];
+    
+    while (current) {
+        if (strcasestr(current->equipment->name, name)) {
+            return current->equipment;
+        }
+        current = current->next;
+    }
+    return NULL;
+}
+
+Equipment* find_by_id(int id) {
+    for (int i = 0; i < item_count; i++) {
+        if (inventory[i].id == id) {
+            return &inventory[i];
+        }
+    }
+    return NULL;
+}
+
+SupplyRequest* find_request_by_id(int req_id) {
+    for (int i = 0; i < request_count; i++) {
+        if (requests[i].req_id == req_id) {
+            return &requests[i];
+        }
+    }
+    return NULL;
+}
+
+StockStatus get_stock_status(const Equipment* item) {
+    if (item->quantity <= item->min_threshold) {
+        return STATUS_LOW;
+    } else if (item->quantity <= (int)(item->min_threshold * 1.5)) {
+        return STATUS_WATCH;
+    }
+    return STATUS_OK;
+}
+
+void get_string_input(const char* prompt, char* buffer, size_t buffer_size) {
+    printf(CYAN "%s" RESET, prompt);
+    read_input_line(buffer, buffer_size);
+}
+
+int get_int_input(const char* prompt, int min_val, int max_val) {
+    char line[INPUT_BUFFER_SIZE];
+    long value;
+    do {
+        printf(CYAN "%s" RESET, prompt);
+        read_input_line(line, sizeof(line));
+        
+        char* end;
+        value = strtol(line, &end, 10);
+        while (isspace((unsigned char)*end)) end++;
+        if (end == line || *end) {
+            printf(RED "❌ Invalid input. Please enter a number.\n" RESET);
+            value = (long)min_val - 1;
+            continue;
+        }
+        
+        if (value < min_val || value > max_val) {
+            printf(YELLOW "⚠️  Value must be between %d and %d.\n" RESET, min_val, max_val);
+        }
+    } while (value < min_val || value > max_val);
+    
+    return (int)value;
+}
+
+// ----------------------------------------------------------------------------
+// Buffered action log
+// ----------------------------------------------------------------------------
+
+FsyncPolicy parse_fsync_policy(const char* name) {
+    if (strcmp(name, "none") == 0) return FSYNC_NONE;
+    if (strcmp(name, "always") == 0) return FSYNC_ALWAYS;
+    return FSYNC_INTERVAL;
+}
+
+int logger_open(Logger* logger, const char* path, FsyncPolicy policy, int flush_ms) {
+    logger->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    logger->length = 0;
+    logger->last_flush_ms = now_ms();
+    logger->stamp_second = (time_t)-1;
+    logger->fsync_policy = policy;
+    logger->flush_ms = flush_ms > 0 ? flush_ms : DEFAULT_LOG_FLUSH_MS;
+    logger->flush_level = LOG_WARNING;
+    logger->lines = logger->writes = logger->fsyncs = 0;
+    return logger->fd >= 0;
+}
+
+// Writes out the buffer; durable flushes also fsync unless the policy is
+// FSYNC_NONE
+void logger_flush(Logger* logger, int durable) {
+    if (logger->fd < 0) return;
+    
+    size_t written = 0;
+    while (written < logger->length) {
+        ssize_t n = write(logger->fd, logger->buffer + written, logger->length - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += n;
+    }
+    if (logger->length) logger->writes++;
+    logger->length = 0;
+    logger->last_flush_ms = now_ms();
+    
+    if (durable && logger->fsync_policy != FSYNC_NONE) {
+        fsync(logger->fd);
+        logger->fsyncs++;
+    }
+}
+
+void logger_write(Logger* logger, LogLevel level, const char* message) {
+    if (logger->fd < 0) return;
+    
+    // ctime()-style stamp, reformatted only when the second changes
+    time_t now = time(NULL);
+    if (now != logger->stamp_second) {
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(logger->stamp, sizeof(logger->stamp), "%a %b %e %H:%M:%S %Y", &local);
+        logger->stamp_second = now;
+    }
+    
+    size_t stamp_length = strlen(logger->stamp);
+    size_t message_length = strlen(message);
+    size_t line_length = stamp_length + message_length + 4;
+    if (line_length > sizeof(logger->buffer)) {
+        message_length -= line_length - sizeof(logger->buffer);
+        line_length = sizeof(logger->buffer);
+    }
+    if (logger->length + line_length > sizeof(logger->buffer)) {
+        logger_flush(logger, 0);
+    }
+    
+    char* out = logger->buffer + logger->length;
+    *out++ = '[';
+    memcpy(out, logger->stamp, stamp_length);
+    out += stamp_length;
+    *out++ = ']';
+    *out++ = ' ';
+    memcpy(out, message, message_length);
+    out += message_length;
+    *out++ = '\n';
+    logger->length += line_length;
+    logger->lines++;
+    
+    if (level >= logger->flush_level || logger->fsync_policy == FSYNC_ALWAYS) {
+        logger_flush(logger, 1);
+    }
+}
+
+// Appends pre-encoded bytes, e.g. binary audit records
+void logger_append(Logger* logger, LogLevel level, const void* bytes, size_t length) {
+    if (logger->fd < 0 || length > sizeof(logger->buffer)) return;
+    
+    if (logger->length + length > sizeof(logger->buffer)) {
+        logger_flush(logger, 0);
+    }
+    memcpy(logger->buffer + logger->length, bytes, length);
+    logger->length += length;
+    logger->lines++;
+    
+    if (level >= logger->flush_level || logger->fsync_policy == FSYNC_ALWAYS) {
+        logger_flush(logger, 1);
+    }
+}
+
+void logger_tick(Logger* logger) {
+    if (logger->length && now_ms() - logger->last_flush_ms >= logger->flush_ms) {
+        logger_flush(logger, 1);
+    }
+}
+
+void logger_close(Logger* logger) {
+    if (logger->fd < 0) return;
+    logger_flush(logger, 1);
+    close(logger->fd);
+    logger->fd = -1;
+}
+
+static void close_action_log(void) {
+    event_ring_stop();
+    logger_close(&action_logger);
+    audit_close(&audit_log);
+    audit_compressor_stop();
+}
+
+void register_log_exit_hook(void) {
+    static int registered = 0;
+    if (!registered) atexit(close_action_log);
+    registered = 1;
+}
+
+// Opened on first use so the configured path and policy are known
+// Writes one line to the action log on the calling thread
+void write_log_line(LogLevel level, const char* action) {
+    if (action_logger.fd < 0) {
+        const char* path = db_config.log_file[0] ? db_config.log_file : LOG_FILE;
+        if (logger_open(&action_logger, path, parse_fsync_policy(db_config.log_fsync),
+                        db_config.log_flush_ms)) {
+            register_log_exit_hook();
+        }
+    }
+    logger_write(&action_logger, level, action);
+}
+
+void log_event(LogLevel level, const char* action) {
+    if (!event_ring_log(level, action)) write_log_line(level, action);
+    
+    if (use_database) {
+        log_to_database(action);
+    }
+}
+
+void log_action(const char* action) {
+    log_event(LOG_INFO, action);
+}
+
+// ----------------------------------------------------------------------------
+// Binary audit log
+// ----------------------------------------------------------------------------
+
+size_t put_varint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+long long wall_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void audit_put_varint(AuditRecord* record, uint64_t value) {
+    if (record->length + 10 > sizeof(record->data)) return;
+    record->length += put_varint(record->data + record->length, value);
+}
+
+void audit_put_bytes(AuditRecord* record, const char* bytes, size_t length) {
+    size_t room = sizeof(record->data) - record->length - 2;
+    if (length > room) length = room;
+    audit_put_varint(record, length);
+    memcpy(record->data + record->length, bytes, length);
+    record->length += length;
+}
+
+void audit_segment_path(char* out, size_t size, const char* dir, int sequence, const char* ext) {
+    snprintf(out, size, "%s/segment-%06d.%s", dir, sequence, ext);
+}
+
+// Maps a whole file read-only. Returns NULL with *mapped_size 0 when the
+// file is missing or empty.
+const uint8_t* map_file(const char* path, size_t* mapped_size) {
+    *mapped_size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    
+    *mapped_size = st.st_size;
+    return data;
+}
+
+// Maps an audit segment and checks its magic. Returns the mapping, or NULL
+// with *mapped_size 0 when the file is missing or invalid.
+const uint8_t* map_audit_file(const char* path, size_t* mapped_size) {
+    const uint8_t* data = map_file(path, mapped_size);
+    if (data && (*mapped_size < AUDIT_MAGIC_LEN || memcmp(data, AUDIT_MAGIC, AUDIT_MAGIC_LEN) != 0)) {
+        munmap((void*)data, *mapped_size);
+        *mapped_size = 0;
+        return NULL;
+    }
+    return data;
+}
+
+// First timestamp in a segment, from the head of its time index
+long long audit_segment_first_us(const char* dir, int sequence) {
+    char path[192];
+    audit_segment_path(path, sizeof(path), dir, sequence, "tidx");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return LLONG_MAX;
+    
+    AuditTimeEntry entry;
+    ssize_t n = pread(fd, &entry, sizeof(entry), 0);
+    close(fd);
+    return n == (ssize_t)sizeof(entry) ? entry.first_us : LLONG_MAX;
+}
+
+int audit_segment_has(const char* dir, int sequence, const char* ext) {
+    char path[192];
+    audit_segment_path(path, sizeof(path), dir, sequence, ext);
+    return access(path, F_OK) == 0;
+}
+
+// Collects the segment numbers found in dir, raw or compressed, in
+// ascending order. Returns the count, or -1 when the directory cannot be
+// read.
+int list_audit_segments(const char* dir, int** sequences) {
+    *sequences = NULL;
+    DIR* handle = opendir(dir);
+    if (!handle) return -1;
+    
+    int count = 0, capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        int sequence, used = 0;
+        if (sscanf(entry->d_name, "segment-%d%n", &sequence, &used) != 1 ||
+            (strcmp(entry->d_name + used, ".audit") != 0 && strcmp(entry->d_name + used, ".zaudit") != 0)) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            int* grown = realloc(*sequences, capacity * sizeof(int));
+            if (!grown) break;
+            *sequences = grown;
+        }
+        (*sequences)[count++] = sequence;
+    }
+    closedir(handle);
+    
+    if (count) qsort(*sequences, count, sizeof(int), compare_ints);
+    
+    // A segment caught mid-compression has both files
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || (*sequences)[unique - 1] != (*sequences)[i]) {
+            (*sequences)[unique++] = (*sequences)[i];
+        }
+    }
+    return unique;
+}
+
+// Opens segment `sequence` and its indexes for appending. New segments
+// start with the magic; blocks already in the time index keep their numbers.
+int audit_open_segment(AuditLog* log, int sequence) {
+    FsyncPolicy policy = parse_fsync_policy(db_config.log_fsync);
+    char path[192];
+    
+    audit_segment_path(path, sizeof(path), log->dir, sequence, "audit");
+    if (!logger_open(&log->data, path, policy, db_config.log_flush_ms)) return 0;
+    audit_segment_path(path, sizeof(path), log->dir, sequence, "tidx");
+    logger_open(&log->time_index, path, policy, db_config.log_flush_ms);
+    audit_segment_path(path, sizeof(path), log->dir, sequence, "iidx");
+    logger_open(&log->item_index, path, policy, db_config.log_flush_ms);
+    if (log->time_index.fd < 0 || log->item_index.fd < 0) {
+        audit_close(log);
+        return 0;
+    }
+    
+    struct stat st;
+    log->segment_bytes = fstat(log->data.fd, &st) == 0 ? st.st_size : 0;
+    if (log->segment_bytes == 0) {
+        logger_append(&log->data, LOG_INFO, AUDIT_MAGIC, AUDIT_MAGIC_LEN);
+        log->segment_bytes = AUDIT_MAGIC_LEN;
+    }
+    log->block = fstat(log->time_index.fd, &st) == 0 ? st.st_size / sizeof(AuditTimeEntry) : 0;
+    log->segment_first_us = log->block ? audit_segment_first_us(log->dir, sequence) : 0;
+    log->block_open = 0;
+    log->sequence = sequence;
+    return 1;
+}
+
+int compare_audit_items(const void* a, const void* b) {
+    const AuditItemEntry* x = a;
+    const AuditItemEntry* y = b;
+    if (x->item_id != y->item_id) return x->item_id < y->item_id ? -1 : 1;
+    return x->block < y->block ? -1 : x->block > y->block;
+}
+
+// Writes the item index of a closed segment sorted by item, so lookups
+// binary-search to an item's blocks instead of reading every entry
+int audit_seal_segment(const char* dir, int sequence) {
+    char path[192], sealed[200];
+    audit_segment_path(path, sizeof(path), dir, sequence, "iidx");
+    FILE* in = fopen(path, "rb");
+    if (!in) return 0;
+    fseek(in, 0, SEEK_END);
+    long count = ftell(in) / (long)sizeof(AuditItemEntry);
+    rewind(in);
+    
+    AuditItemEntry* entries = malloc((count ? count : 1) * sizeof(AuditItemEntry));
+    if (!entries || fread(entries, sizeof(AuditItemEntry), count, in) != (size_t)count) {
+        free(entries);
+        fclose(in);
+        return 0;
+    }
+    fclose(in);
+    qsort(entries, count, sizeof(AuditItemEntry), compare_audit_items);
+    
+    // Written under a temporary name so a reader never sees half a file
+    audit_segment_path(path, sizeof(path), dir, sequence, "sidx");
+    snprintf(sealed, sizeof(sealed), "%s.tmp", path);
+    FILE* out = fopen(sealed, "wb");
+    int ok = out && fwrite(entries, sizeof(AuditItemEntry), count, out) == (size_t)count;
+    if (out && fclose(out) != 0) ok = 0;
+    free(entries);
+    if (ok) ok = rename(sealed, path) == 0;
+    if (!ok) remove(sealed);
+    return ok;
+}
+
+// Writes the parts in order under a temporary name and renames the file
+// into place, so readers see either the old state or the whole new file.
+// System calls only, so a forked child can use it.
+int write_parts_atomic(const char* path, const struct iovec* parts, int count) {
+    char temp[256];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+    
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        const char* data = parts[i].iov_base;
+        size_t left = parts[i].iov_len;
+        while (left > 0) {
+            ssize_t n = write(fd, data, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ok = 0;
+                break;
+            }
+            data += n;
+            left -= n;
+        }
+    }
+    if (ok) ok = fsync(fd) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (ok) ok = rename(temp, path) == 0;
+    if (!ok) unlink(temp);
+    return ok;
+}
+
+int write_file_atomic(const char* path, const void* data, size_t length) {
+    struct iovec part = {(void*)data, length};
+    return write_parts_atomic(path, &part, 1);
+}
+
+// Deflates a closed segment block by block into .zaudit plus a .zidx block
+// index, then drops the raw file. Blocks stay individually readable, so a
+// query inflates only the blocks the time and item indexes select.
+int audit_compress_segment(const char* dir, int sequence) {
+    char path[192];
+    size_t size, time_size;
+    audit_segment_path(path, sizeof(path), dir, sequence, "audit");
+    const uint8_t* data = map_audit_file(path, &size);
+    if (!data) return 0;
+    audit_segment_path(path, sizeof(path), dir, sequence, "tidx");
+    const AuditTimeEntry* times = (const AuditTimeEntry*)map_file(path, &time_size);
+    long blocks = time_size / sizeof(AuditTimeEntry);
+    
+    // compressBound() covers one stream; each block adds its own header
+    size_t capacity = compressBound(size) + blocks * 16 + AUDIT_MAGIC_LEN;
+    uint8_t* packed = malloc(capacity);
+    AuditCompressedEntry* entries = malloc((blocks ? blocks : 1) * sizeof(AuditCompressedEntry));
+    int ok = times && blocks && packed && entries;
+    
+    size_t packed_size = AUDIT_MAGIC_LEN;
+    if (ok) memcpy(packed, AUDIT_COMPRESSED_MAGIC, AUDIT_MAGIC_LEN);
+    for (long b = 0; ok && b < blocks; b++) {
+        size_t start = (size_t)times[b].offset;
+        size_t end = b + 1 < blocks ? (size_t)times[b + 1].offset : size;
+        if (end > size) end = size;
+        if (start < AUDIT_MAGIC_LEN) start = AUDIT_MAGIC_LEN;
+        if (start > end) start = end;
+        
+        uLongf length = capacity - packed_size;
+        ok = compress2(packed + packed_size, &length, data + start, end - start,
+                       Z_BEST_SPEED) == Z_OK;
+        entries[b].offset = packed_size;
+        entries[b].length = (uint32_t)length;
+        entries[b].raw_length = (uint32_t)(end - start);
+        packed_size += length;
+    }
+    
+    // The block index lands first: a .zaudit is never visible without one
+    if (ok) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "zidx");
+        ok = write_file_atomic(path, entries, blocks * sizeof(AuditCompressedEntry));
+    }
+    if (ok) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "zaudit");
+        ok = write_file_atomic(path, packed, packed_size);
+    }
+    if (ok) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "audit");
+        remove(path);
+    }
+    
+    free(entries);
+    free(packed);
+    if (times) munmap((void*)times, time_size);
+    munmap((void*)data, size);
+    return ok;
+}
+
+void audit_remove_segment(const char* dir, int sequence) {
+    static const char* extensions[] = {"zaudit", "audit", "zidx", "tidx", "iidx", "sidx"};
+    char path[192];
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        audit_segment_path(path, sizeof(path), dir, sequence, extensions[i]);
+        remove(path);
+    }
+}
+
+int audit_compressor_stopping(void) {
+    pthread_mutex_lock(&audit_compressor.lock);
+    int stop = audit_compressor.stop;
+    pthread_mutex_unlock(&audit_compressor.lock);
+    return stop;
+}
+
+// One maintenance pass over the closed segments (those before `active`):
+// seal and compress what is still raw, then delete segments whose last
+// event is older than the retention window. A segment ends where the next
+// one begins, so only the next segment's first timestamp is needed.
+void audit_maintain(AuditCompressor* compressor, int active) {
+    int* sequences;
+    int count = list_audit_segments(compressor->dir, &sequences);
+    
+    for (int i = 0; i < count && sequences[i] < active && !audit_compressor_stopping(); i++) {
+        if (!audit_segment_has(compressor->dir, sequences[i], "audit")) continue;
+        if (!audit_segment_has(compressor->dir, sequences[i], "sidx") &&
+            audit_seal_segment(compressor->dir, sequences[i])) {
+            compressor->sealed++;
+        }
+        if (compressor->compress && audit_compress_segment(compressor->dir, sequences[i])) {
+            compressor->compressed++;
+        }
+    }
+    
+    if (compressor->retention_us > 0) {
+        long long cutoff = wall_clock_us() - compressor->retention_us;
+        for (int i = 0; i + 1 < count && sequences[i + 1] <= active; i++) {
+            long long next_first = audit_segment_first_us(compressor->dir, sequences[i + 1]);
+            if (next_first == LLONG_MAX || next_first >= cutoff) break;
+            audit_remove_segment(compressor->dir, sequences[i]);
+            compressor->expired++;
+        }
+    }
+    free(sequences);
+}
+
+void* audit_compressor_main(void* arg) {
+    AuditCompressor* compressor = arg;
+    int fds[AUDIT_PENDING_FDS];
+    
+    // Lowest priority, so on a busy CPU the foreground is never preempted
+    // for maintenance (Linux applies nice values per thread)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+    
+    pthread_mutex_lock(&compressor->lock);
+    while (1) {
+        while (!compressor->pending && !compressor->stop) {
+            pthread_cond_wait(&compressor->wake, &compressor->lock);
+        }
+        int fd_count = compressor->fd_count;
+        memcpy(fds, compressor->fds, fd_count * sizeof(int));
+        compressor->fd_count = 0;
+        compressor->pending = 0;
+        int active = compressor->active_sequence;
+        int stop = compressor->stop;
+        pthread_mutex_unlock(&compressor->lock);
+        
+        for (int i = 0; i < fd_count; i++) {
+            if (compressor->fsync) fsync(fds[i]);
+            close(fds[i]);
+        }
+        if (!stop) audit_maintain(compressor, active);
+        
+        pthread_mutex_lock(&compressor->lock);
+        if (stop) break;
+    }
+    pthread_mutex_unlock(&compressor->lock);
+    return NULL;
+}
+
+// Starts the maintenance thread for dir; its first pass catches up on
+// segments left raw by an earlier run
+void audit_compressor_start(const char* dir, int active) {
+    AuditCompressor* compressor = &audit_compressor;
+    if (compressor->running) return;
+    
+    strncpy(compressor->dir, dir, sizeof(compressor->dir) - 1);
+    compressor->dir[sizeof(compressor->dir) - 1] = '\0';
+    compressor->active_sequence = active;
+    compressor->fsync = parse_fsync_policy(db_config.log_fsync) != FSYNC_NONE;
+    compressor->compress = db_config.audit_compress;
+    compressor->retention_us = (long long)db_config.audit_retention_days * 86400 * 1000000;
+    compressor->stop = 0;
+    compressor->pending = 1;
+    compressor->fd_count = 0;
+    compressor->running = pthread_create(&compressor->thread, NULL, audit_compressor_main, compressor) == 0;
+}
+
+// Queues a closed segment's descriptors and wakes the thread. Without a
+// thread, or with the queue full, they are closed here without an fsync;
+// the next pass still compresses the segment.
+void audit_compressor_submit(const int* fds, int count, int active) {
+    AuditCompressor* compressor = &audit_compressor;
+    pthread_mutex_lock(&compressor->lock);
+    int queued = compressor->running && compressor->fd_count + count <= AUDIT_PENDING_FDS;
+    if (queued) {
+        memcpy(compressor->fds + compressor->fd_count, fds, count * sizeof(int));
+        compressor->fd_count += count;
+    }
+    compressor->active_sequence = active;
+    compressor->pending = 1;
+    pthread_cond_signal(&compressor->wake);
+    pthread_mutex_unlock(&compressor->lock);
+    
+    if (!queued) {
+        for (int i = 0; i < count; i++) close(fds[i]);
+    }
+}
+
+// Stops the thread after its current segment; queued descriptors are
+// still synced and closed
+void audit_compressor_stop(void) {
+    AuditCompressor* compressor = &audit_compressor;
+    if (!compressor->running) return;
+    
+    pthread_mutex_lock(&compressor->lock);
+    compressor->stop = 1;
+    pthread_cond_signal(&compressor->wake);
+    pthread_mutex_unlock(&compressor->lock);
+    pthread_join(compressor->thread, NULL);
+    compressor->running = 0;
+}
+
+// Opens the next segment and hands the full one to the compressor. Only
+// buffered bytes are written here; fsync and close happen in the background.
+// If the next segment cannot be opened, events keep going to the full one
+// and the roll is retried after AUDIT_ROLL_RETRY_US.
+void audit_roll(AuditLog* log, long long now) {
+    Logger* files[] = {&log->item_index, &log->time_index, &log->data};
+    int fds[3];
+    for (int i = 0; i < 3; i++) {
+        logger_flush(files[i], 0);
+        fds[i] = files[i]->fd;
+        files[i]->fd = -1;
+    }
+    
+    int sequence = log->sequence;
+    if (!audit_open_segment(log, sequence + 1)) {
+        int error = errno;
+        audit_close(log);
+        for (int i = 0; i < 3; i++) files[i]->fd = fds[i];
+        if (!log->roll_retry_us) {
+            char message[MAX_LOG_MSG_LEN];
+            snprintf(message, sizeof(message),
+                     "Cannot open audit segment %d (%s); still writing segment %d",
+                     sequence + 1, strerror(error), sequence);
+            write_log_line(LOG_CRITICAL, message);
+        }
+        log->roll_retry_us = now + AUDIT_ROLL_RETRY_US;
+        return;
+    }
+    
+    if (log->roll_retry_us) {
+        write_log_line(LOG_WARNING, "Audit segment roll recovered");
+        log->roll_retry_us = 0;
+    }
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] >= 0) fds[count++] = fds[i];
+    }
+    audit_compressor_submit(fds, count, sequence + 1);
+}
+
+static inline int audit_segment_full(const AuditLog* log, long long now) {
+    if (log->roll_retry_us && now < log->roll_retry_us) return 0;
+    return log->segment_bytes >= log->segment_limit ||
+           (log->rotate_us && log->block && now - log->segment_first_us >= log->rotate_us);
+}
+
+// Starts a block: indexes its offset and first timestamp, then anchors the
+// clock with an absolute SESSION record
+void audit_start_block(AuditLog* log, long long now, LogLevel level) {
+    if (audit_segment_full(log, now)) {
+        audit_roll(log, now);
+        if (log->data.fd < 0) return;
+    }
+    if (log->block == 0) log->segment_first_us = now;
+    
+    AuditTimeEntry entry = {now, log->segment_bytes};
+    logger_append(&log->time_index, level, &entry, sizeof(entry));
+    log->block_start = log->segment_bytes;
+    log->block_item_count = 0;
+    log->block_open = 1;
+    log->block++;
+    
+    AuditRecord session = {{0}, 0};
+    audit_put_varint(&session, (uint64_t)now);
+    uint8_t frame[16];
+    size_t n = 0;
+    frame[n++] = AUDIT_SESSION;
+    frame[n++] = 0;
+    n += put_varint(frame + n, session.length);
+    logger_append(&log->data, level, frame, n);
+    logger_append(&log->data, level, session.data, session.length);
+    log->segment_bytes += n + session.length;
+    log->clock_us = now;
+}
+
+// Adds item_id to the current block's item index, once per block. Returns
+// 0 when the block has no room left for another item.
+int audit_index_item(AuditLog* log, long long item_id, LogLevel level) {
+    for (int i = 0; i < log->block_item_count; i++) {
+        if (log->block_items[i] == (uint32_t)item_id) return 1;
+    }
+    if (log->block_item_count == AUDIT_BLOCK_ITEMS) return 0;
+    
+    log->block_items[log->block_item_count++] = (uint32_t)item_id;
+    AuditItemEntry entry = {(uint32_t)item_id, log->block - 1};
+    logger_append(&log->item_index, level, &entry, sizeof(entry));
+    return 1;
+}
+
+// Frames and appends one record, starting a new block (and segment) when
+// the current one is full. Timestamps never run backwards, even if the
+// wall clock is stepped, so deltas stay unsigned.
+void audit_append(AuditLog* log, AuditType type, const AuditRecord* payload,
+                  long long item_id, long long timestamp_us, LogLevel level) {
+    if (log->data.fd < 0) return;
+    long long now = timestamp_us;
+    if (now < log->clock_us) now = log->clock_us;
+    
+    if (!log->block_open || log->segment_bytes - log->block_start >= AUDIT_BLOCK_BYTES ||
+        audit_segment_full(log, now)) {
+        audit_start_block(log, now, level);
+        if (log->data.fd < 0) return;
+    }
+    if (item_id > 0 && !audit_index_item(log, item_id, level)) {
+        audit_start_block(log, now, level);
+        if (log->data.fd < 0) return;
+        audit_index_item(log, item_id, level);
+    }
+    
+    uint8_t frame[AUDIT_MAX_RECORD + 24];
+    size_t n = 0;
+    frame[n++] = (uint8_t)type;
+    n += put_varint(frame + n, (uint64_t)(now - log->clock_us));
+    n += put_varint(frame + n, payload ? payload->length : 0);
+    if (payload) {
+        memcpy(frame + n, payload->data, payload->length);
+        n += payload->length;
+    }
+    log->clock_us = now;
+    log->segment_bytes += n;
+    logger_append(&log->data, level, frame, n);
+}
+
+// Opens the newest segment in dir for appending, creating the directory
+// if needed. Each session starts a fresh block.
+int audit_open(AuditLog* log, const char* dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return 0;
+    
+    strncpy(log->dir, dir, sizeof(log->dir) - 1);
+    log->dir[sizeof(log->dir) - 1] = '\0';
+    long long limit_kb = db_config.audit_segment_kb > 0 ? db_config.audit_segment_kb
+                                                        : DEFAULT_AUDIT_SEGMENT_KB;
+    log->segment_limit = limit_kb * 1024;
+    log->rotate_us = (long long)db_config.audit_rotate_minutes * 60 * 1000000;
+    log->clock_us = 0;
+    log->roll_retry_us = 0;
+    
+    int* sequences;
+    int count = list_audit_segments(dir, &sequences);
+    int sequence = count > 0 ? sequences[count - 1] : 1;
+    if (count > 0 && !audit_segment_has(dir, sequence, "audit")) sequence++;
+    free(sequences);
+    
+    // The newest segment grows again, so its sorted item index goes stale
+    char sealed[192];
+    audit_segment_path(sealed, sizeof(sealed), dir, sequence, "sidx");
+    remove(sealed);
+    if (!audit_open_segment(log, sequence)) return 0;
+    
+    audit_compressor_start(dir, sequence);
+    audit_start_block(log, wall_clock_us(), LOG_INFO);
+    return log->data.fd >= 0;
+}
+
+void audit_tick(AuditLog* log) {
+    logger_tick(&log->item_index);
+    logger_tick(&log->time_index);
+    logger_tick(&log->data);
+}
+
+void audit_close(AuditLog* log) {
+    logger_close(&log->item_index);
+    logger_close(&log->time_index);
+    logger_close(&log->data);
+}
+
+void write_audit_event(AuditType type, const AuditRecord* payload, long long item_id,
+                       long long timestamp_us, LogLevel level) {
+    if (audit_log.data.fd < 0) {
+        const char* dir = db_config.audit_dir[0] ? db_config.audit_dir : AUDIT_DIR;
+        if (!audit_open(&audit_log, dir)) return;
+        register_log_exit_hook();
+    }
+    audit_append(&audit_log, type, payload, item_id, timestamp_us, level);
+}
+
+// Events are stamped here rather than by the writer, so queued events
+// keep the time they happened
+void audit_event(AuditType type, const AuditRecord* payload, long long item_id, LogLevel level) {
+    long long now = wall_clock_us();
+    if (!event_ring_audit(type, payload, item_id, now, level)) {
+        write_audit_event(type, payload, item_id, now, level);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Event ring
+// ----------------------------------------------------------------------------
+
+// Producers reserve a slot with one CAS on the tail and publish it by
+// storing the slot's sequence; nothing else is shared between them. Only
+// the writer thread touches the loggers while the ring runs.
+
+int event_ring_start(void) {
+    EventRing* ring = &event_ring;
+    if (ring->running) return 1;
+    
+    ring->slots = aligned_alloc(64, EVENT_RING_SLOTS * sizeof(RingSlot));
+    if (!ring->slots) return 0;
+    for (size_t i = 0; i < EVENT_RING_SLOTS; i++) {
+        atomic_init(&ring->slots[i].sequence, i);
+    }
+    ring->mask = EVENT_RING_SLOTS - 1;
+    atomic_init(&ring->tail, 0);
+    ring->head = 0;
+    atomic_init(&ring->sleeping, 0);
+    atomic_init(&ring->overflows, 0);
+    atomic_init(&ring->stop, 0);
+    ring->consumed = ring->batches = 0;
+    
+    if (pthread_create(&ring->thread, NULL, event_ring_main, ring) != 0) {
+        free(ring->slots);
+        ring->slots = NULL;
+        return 0;
+    }
+    atomic_store(&ring->running, 1);
+    register_log_exit_hook();
+    return 1;
+}
+
+static void event_ring_wake(EventRing* ring) {
+    pthread_mutex_lock(&ring->lock);
+    if (atomic_load(&ring->sleeping)) {
+        atomic_store(&ring->sleeping, 0);
+        pthread_cond_signal(&ring->wake);
+    }
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Reserves the next free slot, yielding while the ring is full. A full
+// ring is counted once per event that had to wait.
+static RingSlot* event_ring_reserve(EventRing* ring, size_t* position) {
+    int waited = 0;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (1) {
+        RingSlot* slot = &ring->slots[tail & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)tail;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *position = tail;
+                return slot;
+            }
+        } else if (difference < 0) {
+            if (!waited) atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+            waited = 1;
+            event_ring_wake(ring);
+            sched_yield();
+            tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        } else {
+            tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// Makes the slot visible to the writer. Producers wake a sleeping writer
+// only for warnings and once per EVENT_RING_BATCH positions; everything
+// else waits for the writer's next tick, so the common case is two atomics.
+static void event_ring_publish(EventRing* ring, RingSlot* slot, size_t position, LogLevel level) {
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    if (level < LOG_WARNING && (position & (EVENT_RING_BATCH - 1)) != 0) return;
+    
+    // Pairs with the writer setting `sleeping` before its last look
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed)) event_ring_wake(ring);
+}
+
+int event_ring_log(LogLevel level, const char* message) {
+    EventRing* ring = &event_ring;
+    if (!atomic_load_explicit(&ring->running, memory_order_acquire)) return 0;
+    
+    size_t position;
+    RingSlot* slot = event_ring_reserve(ring, &position);
+    slot->kind = RING_LOG_LINE;
+    slot->level = (uint8_t)level;
+    size_t length = strlen(message);
+    if (length >= sizeof(slot->text)) length = sizeof(slot->text) - 1;
+    memcpy(slot->text, message, length);
+    slot->text[length] = '\0';
+    event_ring_publish(ring, slot, position, level);
+    return 1;
+}
+
+int event_ring_audit(AuditType type, const AuditRecord* payload, long long item_id,
+                     long long timestamp_us, LogLevel level) {
+    EventRing* ring = &event_ring;
+    if (!atomic_load_explicit(&ring->running, memory_order_acquire)) return 0;
+    
+    size_t position;
+    RingSlot* slot = event_ring_reserve(ring, &position);
+    slot->kind = RING_AUDIT;
+    slot->level = (uint8_t)level;
+    slot->audit_type = (uint8_t)type;
+    slot->item_id = item_id;
+    slot->timestamp_us = timestamp_us;
+    slot->record.length = payload ? payload->length : 0;
+    if (payload) memcpy(slot->record.data, payload->data, payload->length);
+    event_ring_publish(ring, slot, position, level);
+    return 1;
+}
+
+// Writes up to `limit` published events in order and frees their slots.
+// Returns the number consumed.
+static int event_ring_drain(EventRing* ring, int limit) {
+    int count = 0;
+    while (count < limit) {
+        RingSlot* slot = &ring->slots[ring->head & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != ring->head + 1) break;
+        
+        if (slot->kind == RING_LOG_LINE) {
+            write_log_line((LogLevel)slot->level, slot->text);
+        } else {
+            write_audit_event((AuditType)slot->audit_type, &slot->record, slot->item_id,
+                              slot->timestamp_us, (LogLevel)slot->level);
+        }
+        atomic_store_explicit(&slot->sequence, ring->head + EVENT_RING_SLOTS, memory_order_release);
+        ring->head++;
+        count++;
+    }
+    if (count) {
+        ring->consumed += count;
+        ring->batches++;
+    }
+    return count;
+}
+
+static int event_ring_pending(EventRing* ring) {
+    RingSlot* slot = &ring->slots[ring->head & ring->mask];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == ring->head + 1;
+}
+
+void* event_ring_main(void* arg) {
+    EventRing* ring = arg;
+    while (1) {
+        if (event_ring_drain(ring, EVENT_RING_BATCH) == EVENT_RING_BATCH) {
+            // Still busy: honour flush_ms between batches
+            logger_tick(&action_logger);
+            audit_tick(&audit_log);
+            continue;
+        }
+        logger_tick(&action_logger);
+        audit_tick(&audit_log);
+        
+        pthread_mutex_lock(&ring->lock);
+        atomic_store(&ring->sleeping, 1);
+        if (event_ring_pending(ring) || atomic_load(&ring->stop)) {
+            atomic_store(&ring->sleeping, 0);
+            pthread_mutex_unlock(&ring->lock);
+            if (atomic_load(&ring->stop) && !event_ring_pending(ring)) break;
+            continue;
+        }
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += EVENT_TICK_MS * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&ring->wake, &ring->lock, &until);
+        atomic_store(&ring->sleeping, 0);
+        pthread_mutex_unlock(&ring->lock);
+    }
+    return NULL;
+}
+
+// Drains everything published so far, then stops the writer. The loggers
+// belong to the caller again afterwards.
+void event_ring_stop(void) {
+    EventRing* ring = &event_ring;
+    if (!atomic_load(&ring->running)) return;
+    
+    atomic_store(&ring->running, 0);
+    pthread_mutex_lock(&ring->lock);
+    atomic_store(&ring->stop, 1);
+    pthread_cond_signal(&ring->wake);
+    pthread_mutex_unlock(&ring->lock);
+    pthread_join(ring->thread, NULL);
+    
+    long overflows = atomic_load(&ring->overflows);
+    if (overflows) {
+        char message[MAX_LOG_MSG_LEN];
+        snprintf(message, sizeof(message), "Event ring was full %ld times; producers waited", overflows);
+        write_log_line(LOG_WARNING, message);
+    }
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+// The database audit table keeps its free-text form; it is only formatted
+// when a database is attached
+
+// journal_* write the binary record only; audit_* also add the database
+// audit_log line for changes made at this station
+
+void journal_add_equipment(const Equipment* item) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, item->id);
+    audit_put_varint(&record, item->quantity);
+    audit_put_bytes(&record, item->name, strlen(item->name));
+    audit_put_varint(&record, item->min_threshold);
+    audit_put_varint(&record, item->classification);
+    audit_put_bytes(&record, item->description, strlen(item->description));
+    audit_put_bytes(&record, item->unit, strlen(item->unit));
+    audit_put_bytes(&record, item->location, strlen(item->location));
+    audit_event(AUDIT_ADD, &record, item->id, LOG_INFO);
+}
+
+void audit_add_equipment(const Equipment* item) {
+    journal_add_equipment(item);
+    if (use_database) {
+        char log_msg[MAX_LOG_MSG_LEN];
+        snprintf(log_msg, sizeof(log_msg), "Added equipment: %s (ID: %d)", item->name, item->id);
+        log_to_database(log_msg);
+    }
+}
+
+void journal_update_quantity(const Equipment* item, int old_qty) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, item->id);
+    audit_put_varint(&record, zigzag_encode(old_qty));
+    audit_put_varint(&record, zigzag_encode(item->quantity));
+    audit_event(AUDIT_UPDATE_QTY, &record, item->id, LOG_INFO);
+}
+
+void audit_update_quantity(const Equipment* item, int old_qty) {
+    journal_update_quantity(item, old_qty);
+    if (use_database) {
+        char log_msg[MAX_LOG_MSG_LEN];
+        snprintf(log_msg, sizeof(log_msg), "Updated %s quantity: %d -> %d",
+                 item->name, old_qty, item->quantity);
+        log_to_database(log_msg);
+    }
+}
+
+void journal_request(const SupplyRequest* req) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, req->req_id);
+    audit_put_varint(&record, req->equipment_id);
+    audit_put_varint(&record, req->requested_qty);
+    audit_put_varint(&record, req->priority);
+    audit_put_varint(&record, req->status);
+    audit_put_bytes(&record, req->requesting_unit, strlen(req->requesting_unit));
+    audit_put_varint(&record, req->request_time);
+    audit_event(AUDIT_REQUEST, &record, req->equipment_id, LOG_INFO);
+}
+
+void journal_delete_equipment(int id) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, id);
+    audit_event(AUDIT_DELETE_ITEM, &record, id, LOG_INFO);
+}
+
+void journal_delete_request(const SupplyRequest* req) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, req->req_id);
+    audit_put_varint(&record, req->equipment_id);
+    audit_event(AUDIT_DELETE_REQUEST, &record, req->equipment_id, LOG_INFO);
+}
+
+void audit_supply_request(const SupplyRequest* req) {
+    journal_request(req);
+    if (use_database) {
+        char log_msg[MAX_LOG_MSG_LEN];
+        snprintf(log_msg, sizeof(log_msg), "Supply request created: REQ-%d for equipment ID %d",
+                 req->req_id, req->equipment_id);
+        log_to_database(log_msg);
+    }
+}
+
+void audit_export(long rows) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, rows);
+    audit_event(AUDIT_EXPORT, &record, 0, LOG_INFO);
+    if (use_database) log_to_database("Inventory report exported");
+}
+
+void audit_startup(long long startup_ms) {
+    AuditRecord record = {{0}, 0};
+    audit_put_varint(&record, startup_ms);
+    audit_event(AUDIT_STARTUP, &record, 0, LOG_INFO);
+}
+
+void audit_shutdown(void) {
+    audit_event(AUDIT_SHUTDOWN, NULL, 0, LOG_INFO);
+    if (use_database) log_to_database("System shutdown");
+}
+
+int calculate_checksum(const Equipment* item) {
+    int sum = item->id + item->quantity + item->min_threshold;
+    for (int i = 0; item->name[i]; i++) {
+        sum += item->name[i];
+    }
+    return sum % 10000;
+}
+
+// ----------------------------------------------------------------------------
+// Parallel load
+// ----------------------------------------------------------------------------
+
+// Workers to split count records across: load_threads if set, otherwise
+// one per core as long as each gets LOAD_MIN_SHARD records. Below that
+// thread startup and page faults cost more than the copy, so a default
+// build (MAX_ITEMS 1000) always loads on one thread.
+int load_thread_count(int count) {
+    long threads = db_config.load_threads;
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > count / LOAD_MIN_SHARD) threads = count / LOAD_MIN_SHARD;
+    }
+    if (threads > LOAD_MAX_THREADS) threads = LOAD_MAX_THREADS;
+    return threads < 1 ? 1 : (int)threads;
+}
+
+// One worker: copies its slice into inventory[], checks each record's
+// checksum and chains the slice into its own buckets. Nodes go in at the
+// head, as hash_insert() does, so each bucket also remembers its first node
+// as the tail the merge links the previous chain to.
+void* load_shard_main(void* arg) {
+    LoadShard* shard = arg;
+    Equipment* items = &inventory[shard->first];
+    size_t bytes = (size_t)shard->count * sizeof(Equipment);
+    if (shard->source) {
+        memcpy(items, shard->source, bytes);
+        shard->crc = crc32_z(0L, (const Bytef*)items, bytes);
+    }
+    
+    for (int i = 0; i < shard->count; i++) {
+        Equipment* item = &items[i];
+        if (shard->flags & LOAD_VERIFY) {
+            char expected[16];
+            snprintf(expected, sizeof(expected), "%04d", calculate_checksum(item));
+            if (strncmp(expected, item->checksum, sizeof(item->checksum)) != 0 && shard->mismatches++ == 0) {
+                shard->first_mismatch_id = item->id;
+            }
+        }
+        if (shard->flags & LOAD_INDEX) {
+            unsigned int index = hash_function(item->name);
+            HashNode* node = malloc(sizeof(HashNode));
+            node->equipment = item;
+            node->next = shard->heads[index];
+            if (!node->next) shard->tails[index] = node;
+            shard->heads[index] = node;
+        }
+    }
+    return NULL;
+}
+
+// Loads count records into inventory[0..count) from source (NULL = they
+// are already there) on `threads` workers (0 = load_thread_count()), each
+// taking a contiguous slice. LOAD_VERIFY counts records whose checksum is
+// wrong; LOAD_INDEX replaces hash_table with the slices' chains, spliced
+// in slice order so every bucket matches what inserting one record at a
+// time would have built. stats (may be NULL) gets the CRC32 of the copied
+// records and the checksum failures.
+void load_equipment_records(const Equipment* source, int count, int flags, int threads, LoadStats* stats) {
+    if (threads <= 0) threads = load_thread_count(count);
+    if (threads > count) threads = count > 1 ? count : 1;
+    
+    LoadShard single = {0};
+    LoadShard* shards = threads > 1 ? calloc(threads, sizeof(LoadShard)) : NULL;
+    if (!shards) {
+        threads = 1;
+        shards = &single;
+    }
+    if (flags & LOAD_INDEX) hash_clear();
+    
+    int first = 0;
+    for (int i = 0; i < threads; i++) {
+        LoadShard* shard = &shards[i];
+        shard->first = first;
+        shard->count = count / threads + (i < count % threads);
+        shard->source = source ? source + first : NULL;
+        shard->flags = flags;
+        first += shard->count;
+        // The caller takes the first slice itself
+        if (i > 0) shard->started = pthread_create(&shard->thread, NULL, load_shard_main, shard) == 0;
+    }
+    load_shard_main(&shards[0]);
+    for (int i = 1; i < threads; i++) {
+        if (shards[i].started) {
+            pthread_join(shards[i].thread, NULL);
+        } else {
+            load_shard_main(&shards[i]);
+        }
+    }
+    
+    LoadStats totals = {0, 0, 0, threads};
+    for (int i = 0; i < threads; i++) {
+        LoadShard* shard = &shards[i];
+        totals.crc = i == 0 ? shard->crc
+                            : crc32_combine(totals.crc, shard->crc, (z_off_t)shard->count * sizeof(Equipment));
+        if (shard->mismatches && !totals.mismatches) totals.first_mismatch_id = shard->first_mismatch_id;
+        totals.mismatches += shard->mismatches;
+        if (!(flags & LOAD_INDEX)) continue;
+        for (int b = 0; b < HASH_SIZE; b++) {
+            if (!shard->heads[b]) continue;
+            shard->tails[b]->next = hash_table[b];
+            hash_table[b] = shard->heads[b];
+        }
+    }
+    if (shards != &single) free(shards);
+    if (stats) *stats = totals;
+}
+
+// Maps an equipment data file (item count, next ID, records) into
+// inventory[], verifying and indexing the records on `threads` workers
+// (0 = load_thread_count()). Returns the item count the file declares,
+// which is more than item_count when the file is short or exceeds
+// MAX_ITEMS, or -1 when there is no file to load.
+int load_equipment_file(const char* path, int threads, LoadStats* stats) {
+    size_t size;
+    const uint8_t* data = map_file(path, &size);
+    if (!data) return -1;
+    
+    int header[2] = {0, 1};
+    if (size >= sizeof(header)) memcpy(header, data, sizeof(header));
+    size_t present = size >= sizeof(header) ? (size - sizeof(header)) / sizeof(Equipment) : 0;
+    int count = header[0] < 0 ? 0 : header[0];
+    if ((size_t)count > present) count = (int)present;
+    if (count > MAX_ITEMS) count = MAX_ITEMS;
+    
+    load_equipment_records((const Equipment*)(data + sizeof(header)), count, LOAD_VERIFY | LOAD_INDEX,
+                           threads, stats);
+    item_count = count;
+    next_item_id = header[1];
+    munmap((void*)data, size);
+    return header[0] < 0 ? 0 : header[0];
+}
+
+// Warns about records whose stored checksum does not match their contents
+void report_checksum_mismatches(const char* source, const LoadStats* stats) {
+    if (!stats->mismatches) return;
+    char message[MAX_LOG_MSG_LEN];
+    snprintf(message, sizeof(message), "%s: %d equipment record%s failed checksum verification (first ID %d)",
+             source, stats->mismatches, stats->mismatches == 1 ? "" : "s", stats->first_mismatch_id);
+    printf(YELLOW "⚠️  %s\n" RESET, message);
+    log_event(LOG_WARNING, message);
+}
+
+void display_equipment_details(const Equipment* item) {
+    StockStatus status = get_stock_status(item);
+    
+    display_classification_banner(item->classification);
+    
+    printf(BOLD WHITE "📦 EQUIPMENT DETAILS\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    printf(CYAN "ID: " WHITE "%d\n" RESET, item->id);
+    printf(CYAN "Name: " WHITE "%s\n" RESET, item->name);
+    printf(CYAN "Description: " WHITE "%s\n" RESET, item->description);
+    printf(CYAN "Quantity: " WHITE "%d %s\n" RESET, item->quantity, item->unit);
+    printf(CYAN "Location: " WHITE "%s\n" RESET, item->location);
+    printf(CYAN "Min Threshold: " WHITE "%d\n" RESET, item->min_threshold);
+    
+    switch (status) {
+        case STATUS_LOW:
+            printf(BOLD RED "🚨 STATUS: *** LOW STOCK - RESUPPLY REQUIRED ***\n" RESET);
+            break;
+        case STATUS_WATCH:
+            printf(BOLD YELLOW "⚠️  STATUS: CAUTION - Monitor stock levels\n" RESET);
+            break;
+        case STATUS_OK:
+            printf(BOLD GREEN "✅ STATUS: ADEQUATE\n" RESET);
+            break;
+    }
+    
+    printf(CYAN "Last Updated: " WHITE "%s" RESET, ctime(&item->last_updated));
+    printf(CYAN "Checksum: " WHITE "%s\n" RESET, item->checksum);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+}
+
+void display_equipment_table_header(void) {
+    printf(BOLD WHITE);
+    printf("┌──────┬──────────────────────┬──────────┬────────┬─────────────────┬────────────┐\n");
+    printf("│ %-4s │ %-20s │ %-8s │ %-6s │ %-15s │ %-10s │\n", 
+           "ID", "NAME", "QTY", "UNIT", "LOCATION", "STATUS");
+    printf("├──────┼──────────────────────┼──────────┼────────┼─────────────────┼────────────┤\n");
+    printf(RESET);
+}
+
+void display_equipment_row(const Equipment* item) {
+    StockStatus status = get_stock_status(item);
+    const char* status_color = (status == STATUS_LOW) ? RED : 
+                              (status == STATUS_WATCH) ? YELLOW : GREEN;
+    
+    printf("│ %-4d │ %-20s │ %s%-8d%s │ %-6s │ %-15s │ %s%-10s%s │\n",
+           item->id, item->name, WHITE, item->quantity, RESET,
+           item->unit, item->location, status_color, STOCK_STATUS_NAMES[status], RESET);
+}
+
+void display_equipment_table_footer(int count) {
+    printf("└──────┴──────────────────────┴──────────┴────────┴─────────────────┴────────────┘\n");
+    printf(BOLD CYAN "Total Equipment Items: %d\n" RESET, count);
+}
+
+// ============================================================================
+// WRITE-BEHIND CACHE
+// ============================================================================
+
+// Appends value to a Postgres array literal, quoting and escaping it
+static size_t append_array_element(char* buffer, size_t len, const char* value) {
+    buffer[len] = len ? ',' : '{';
+    len++;
+    buffer[len++] = '"';
+    for (const char* p = value; *p; p++) {
+        if (*p == '"' || *p == '\\') buffer[len++] = '\\';
+        buffer[len++] = *p;
+    }
+    buffer[len++] = '"';
+    return len;
+}
+
+// Writes all coalesced updates and queued audit lines in one statement, so
+// a whole batch costs a single round trip and commits atomically.
+int write_behind_flush(void) {
+    WriteBehindCache* cache = &write_behind;
+    if (!db_conn || (cache->update_count == 0 && cache->audit_count == 0)) return 1;
+    
+    size_t id_size = cache->update_count * 12 + 3;
+    size_t audit_size = cache->audit_count * (2 * MAX_LOG_MSG_LEN + 3) + 3;
+    char* ids = malloc(id_size);
+    char* quantities = malloc(id_size);
+    char* checksums = malloc(cache->update_count * 20 + 3);
+    char* audit = malloc(audit_size);
+    if (!ids || !quantities || !checksums || !audit) {
+        free(ids); free(quantities); free(checksums); free(audit);
+        return 0;
+    }
+    
+    size_t id_len = 0, qty_len = 0, sum_len = 0, audit_len = 0;
+    for (int i = 0; i < cache->update_count; i++) {
+        const PendingUpdate* update = &cache->updates[i];
+        id_len += sprintf(ids + id_len, "%c%d", i ? ',' : '{', update->id);
+        qty_len += sprintf(quantities + qty_len, "%c%d", i ? ',' : '{', update->quantity);
+        sum_len = append_array_element(checksums, sum_len, update->checksum);
+    }
+    for (int i = 0; i < cache->audit_count; i++) {
+        audit_len = append_array_element(audit, audit_len, cache->audit[i]);
+    }
+    strcpy(ids + id_len, id_len ? "}" : "{}");
+    strcpy(quantities + qty_len, qty_len ? "}" : "{}");
+    strcpy(checksums + sum_len, sum_len ? "}" : "{}");
+    strcpy(audit + audit_len, audit_len ? "}" : "{}");
+    
+    const char* params[4] = {ids, quantities, checksums, audit};
+    PGresult* res = execute_params_query(
+        "WITH updated AS ("
+        "  UPDATE equipment AS e SET quantity = v.quantity, checksum = v.checksum, "
+        "    last_updated = CURRENT_TIMESTAMP "
+        "  FROM unnest($1::int[], $2::int[], $3::text[]) AS v(id, quantity, checksum) "
+        "  WHERE e.id = v.id RETURNING e.id) "
+        "INSERT INTO audit_log (action, user_info) "
+        "SELECT unnest($4::text[]), 'system'",
+        4, params, PGRES_COMMAND_OK);
+    
+    free(ids); free(quantities); free(checksums); free(audit);
+    
+    // On failure the batch stays queued and is retried on the next flush
+    if (!res) return 0;
+    PQclear(res);
+    
+    cache->update_count = 0;
+    cache->audit_count = 0;
+    cache->flushes++;
+    return 1;
+}
+
+static void write_behind_touch(void) {
+    WriteBehindCache* cache = &write_behind;
+    if (cache->update_count == 0 && cache->audit_count == 0) {
+        cache->oldest_ms = now_ms();
+    }
+}
+
+// Queues the item's current quantity, replacing any older pending value
+// for the same ID. Falls back to a synchronous write if the cache is full
+// and cannot be drained.
+void write_behind_queue_update(const Equipment* item) {
+    WriteBehindCache* cache = &write_behind;
+    
+    for (int i = 0; i < cache->update_count; i++) {
+        if (cache->updates[i].id == item->id) {
+            cache->updates[i].quantity = item->quantity;
+            strcpy(cache->updates[i].checksum, item->checksum);
+            return;
+        }
+    }
+    
+    if (cache->update_count == WRITE_BEHIND_MAX && !write_behind_flush()) {
+        update_equipment_in_db(item);
+        return;
+    }
+    
+    write_behind_touch();
+    PendingUpdate* update = &cache->updates[cache->update_count++];
+    update->id = item->id;
+    update->quantity = item->quantity;
+    strcpy(update->checksum, item->checksum);
+}
+
+void write_behind_queue_audit(const char* action) {
+    WriteBehindCache* cache = &write_behind;
+    
+    // A full batch that cannot be flushed: write this line on its own, and
+    // if that fails too, record it in the local log. log_event() would
+    // queue it here again.
+    if (cache->audit_count == WRITE_BEHIND_MAX && !write_behind_flush()) {
+        if (!insert_audit_row(action)) {
+            char message[MAX_LOG_MSG_LEN];
+            snprintf(message, sizeof(message), "Not in audit_log (batch full, insert failed): %s", action);
+            printf(YELLOW "⚠️  Warning: %s\n" RESET, message);
+            if (!event_ring_log(LOG_WARNING, message)) write_log_line(LOG_WARNING, message);
+        }
+        return;
+    }
+    
+    write_behind_touch();
+    strncpy(cache->audit[cache->audit_count], action, MAX_LOG_MSG_LEN - 1);
+    cache->audit[cache->audit_count][MAX_LOG_MSG_LEN - 1] = 0;
+    cache->audit_count++;
+}
+
+// Flushes once the oldest pending change has waited write_behind_ms.
+// Called from run_event_timers() on every EVENT_TICK_MS tick while a
+// prompt waits, never from a menu redraw, so edits made between redraws
+// still coalesce. Reads that must see pending changes (searches,
+// listings, notification refreshes, replica routing) flush explicitly.
+void write_behind_tick(void) {
+    WriteBehindCache* cache = &write_behind;
+    if (cache->update_count == 0 && cache->audit_count == 0) return;
+    
+    if (now_ms() - cache->oldest_ms >= db_config.write_behind_ms) {
+        write_behind_flush();
+    }
+}
+
+// ============================================================================
+// INCREMENTAL RESYNC
+// ============================================================================
+
+#define RESYNC_MAX_LOCAL_WRITES 256
+
+// Counters for the resync job in flight
+typedef struct {
+    int running;
+    int equipment_changed;
+    int requests_changed;
+    int stale;              // Rows skipped because this station wrote the item later
+    int announce;           // Report the outcome even when nothing changed
+    double started_watermark;
+    int local_writes;       // Items updated or deleted here since the job started
+    int local_ids[RESYNC_MAX_LOCAL_WRITES];
+} ResyncJob;
+
+ResyncJob resync_job;
+
+// The resync reads a snapshot taken when its query started, but its rows
+// are applied later, at the menu. An item changed here in between would
+// be put back to the old value, and our own notification that could fix
+// it is ignored, so such items are remembered and their rows skipped.
+void resync_note_local_write(int id) {
+    if (!resync_job.running) return;
+    for (int i = 0; i < resync_job.local_writes && i < RESYNC_MAX_LOCAL_WRITES; i++) {
+        if (resync_job.local_ids[i] == id) return;
+    }
+    if (resync_job.local_writes < RESYNC_MAX_LOCAL_WRITES) {
+        resync_job.local_ids[resync_job.local_writes] = id;
+    }
+    resync_job.local_writes++;
+}
+
+// Past RESYNC_MAX_LOCAL_WRITES every row is treated as stale, and the
+// watermark is wound back at the end so the next resync reads them again
+int resync_row_is_stale(int id) {
+    if (resync_job.local_writes > RESYNC_MAX_LOCAL_WRITES) return 1;
+    for (int i = 0; i < resync_job.local_writes; i++) {
+        if (resync_job.local_ids[i] == id) return 1;
+    }
+    return 0;
+}
+
+int resync_equipment_row(const PGresult* res, int row, void* ctx) {
+    Equipment fresh = {0};
+    equipment_from_row(&fresh, res, row);
+    if (resync_row_is_stale(fresh.id)) {
+        resync_job.stale++;
+    } else {
+        upsert_equipment(&fresh);
+        (*(int*)ctx)++;
+    }
+    
+    double changed_at = atof(PQgetvalue(res, row, 9));
+    if (changed_at > equipment_watermark) equipment_watermark = changed_at;
+    return 1;
+}
+
+int resync_request_row(const PGresult* res, int row, void* ctx) {
+    SupplyRequest fresh = {0};
+    request_from_row(&fresh, res, row);
+    upsert_request(&fresh);
+    
+    double changed_at = atof(PQgetvalue(res, row, 7));
+    if (changed_at > request_watermark) request_watermark = changed_at;
+    (*(int*)ctx)++;
+    return 1;
+}
+
+// Fetches only rows changed since the last seen watermark and merges them
+// into the local store. A small overlap window re-reads rows committed out
+// of timestamp order; merging is idempotent so the overlap is harmless.
+// Deletions are not visible here and are handled by change notifications.
+//
+// The timestamps are now() in the writer's transaction, i.e. when it
+// started, not when it committed. A transaction that commits more than
+// resync_overlap seconds after a resync has read past its start time is
+// missed by every later resync. Only its NOTIFY, sent at commit, brings
+// that change in.
+int send_resync_stage(BackgroundJob* job) {
+    char query[MAX_QUERY_LEN];
+    
+    if (job->stage == 0) {
+        snprintf(query, sizeof(query),
+                 "SELECT id, name, description, quantity, min_threshold, "
+                 "unit, location, classification, checksum, "
+                 "EXTRACT(EPOCH FROM last_updated) FROM equipment "
+                 "WHERE last_updated > to_timestamp(%.6f) ORDER BY last_updated",
+                 equipment_watermark - db_config.resync_overlap);
+        job->on_row = resync_equipment_row;
+        job->ctx = &resync_job.equipment_changed;
+    } else if (job->stage == 1) {
+        snprintf(query, sizeof(query),
+                 "SELECT req_id, equipment_id, requested_qty, requesting_unit, "
+                 "EXTRACT(EPOCH FROM request_time), status, priority, "
+                 "EXTRACT(EPOCH FROM updated_at) FROM supply_requests "
+                 "WHERE updated_at > to_timestamp(%.6f) ORDER BY updated_at",
+                 request_watermark - db_config.resync_overlap);
+        job->on_row = resync_request_row;
+        job->ctx = &resync_job.requests_changed;
+    } else {
+        return 0;
+    }
+    return send_background_query(query);
+}
+
+void finish_resync(BackgroundJob* job, int ok) {
+    last_resync = time(NULL);
+    resync_job.running = 0;
+    if (resync_job.local_writes > RESYNC_MAX_LOCAL_WRITES) {
+        equipment_watermark = resync_job.started_watermark;
+    }
+    
+    if (!ok) {
+        printf(RED "\n❌ Background resync failed.\n" RESET);
+    } else if (resync_job.announce || resync_job.equipment_changed || resync_job.requests_changed) {
+        printf(GREEN "\n✅ Resync merged %d equipment and %d request changes in %lld ms.\n" RESET,
+               resync_job.equipment_changed, resync_job.requests_changed,
+               now_ms() - job->started_ms);
+    }
+    if (ok && resync_job.stale) {
+        printf(YELLOW "   %d row(s) skipped: changed here while the resync ran.\n" RESET, resync_job.stale);
+    }
+    fflush(stdout);
+}
+
+// Starts an incremental resync on the background connection. Rows are
+// merged as they stream in, but only while the operator is at the menu.
+int start_background_resync(int announce) {
+    if (!db_conn || !resync_supported || background_job.active) return 0;
+    
+    // Pending local writes must land first or the merge would revert them
+    write_behind_flush();
+    
+    memset(&resync_job, 0, sizeof(resync_job));
+    resync_job.announce = announce;
+    resync_job.started_watermark = equipment_watermark;
+    resync_job.running = 1;
+    
+    BackgroundJob job = {0};
+    strcpy(job.label, "Resync");
+    job.mutates_store = 1;
+    job.send_stage = send_resync_stage;
+    job.on_finish = finish_resync;
+    if (!start_background_job(&job)) {
+        resync_job.running = 0;
+        last_resync = time(NULL);
+        return 0;
+    }
+    return 1;
+}
+
+void resync_database(void) {
+    display_banner();
+    printf(BOLD YELLOW "🔄 RESYNC FROM DATABASE\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (!use_database) {
+        printf(YELLOW "⚠️  Resync is only available in database mode.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    if (background_job.active) {
+        printf(YELLOW "⚠️  %s is already running in the background.\n" RESET, background_job.label);
+        wait_for_enter();
+        return;
+    }
+    
+    if (!start_background_resync(1)) {
+        printf(RED "❌ Resync failed.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    printf(GREEN "⏳ Resync started in the background; changes merge while you work.\n" RESET);
+    wait_for_enter();
+}
+
+// ============================================================================
+// DATABASE REPORTS
+// ============================================================================
+
+// Same thresholds as get_stock_status(); (min * 3) / 2 truncates like the
+// C cast so both sides agree on borderline items
+#define SQL_STOCK_STATUS \
+    "CASE WHEN quantity <= min_threshold THEN 2 " \
+    "WHEN quantity <= (min_threshold * 3) / 2 THEN 1 ELSE 0 END"
+
+#define SQL_INVENTORY_SUMMARY \
+    "SELECT LEAST(GREATEST(classification, 0), 3), " SQL_STOCK_STATUS ", " \
+    "count(*), COALESCE(sum(quantity), 0) FROM equipment GROUP BY 1, 2"
+
+int summary_from_row(const PGresult* res, int row, void* ctx) {
+    InventorySummary* summary = ctx;
+    int classification = atoi(PQgetvalue(res, row, 0));
+    int status = atoi(PQgetvalue(res, row, 1));
+    summary->items[classification][status] = atoi(PQgetvalue(res, row, 2));
+    summary->quantity[classification][status] = atoll(PQgetvalue(res, row, 3));
+    return 1;
+}
+
+int summarize_inventory_in_db(InventorySummary* summary) {
+    memset(summary, 0, sizeof(InventorySummary));
+    
+    PGresult* res = execute_read_query(SQL_INVENTORY_SUMMARY, PGRES_TUPLES_OK);
+    if (!res) return 0;
+    
+    for (int r = 0; r < PQntuples(res); r++) {
+        summary_from_row(res, r, summary);
+    }
+    PQclear(res);
+    return 1;
+}
+
+// Streams low-stock rows; the predicate matches the stock margin index
+int stream_low_stock_from_db(RowHandler handler, void* ctx) {
+    return stream_read_query("low_stock_cur",
+                             "SELECT id, name, quantity, min_threshold, location FROM equipment "
+                             "WHERE quantity - min_threshold <= 0 "
+                             "ORDER BY quantity - min_threshold, id",
+                             handler, ctx);
+}
+
+// Ranked name search served by the trigram GIN index. Substring matches
+// come first, then fuzzy matches by similarity. Without pg_trgm it falls
+// back to a plain ILIKE. Returns the result set or NULL on failure.
+PGresult* search_equipment_in_db(const char* term) {
+    // Escape LIKE wildcards so the term is matched literally
+    char pattern[MAX_NAME_LEN * 2 + 3];
+    size_t len = 0;
+    pattern[len++] = '%';
+    for (const char* p = term; *p && len < sizeof(pattern) - 3; p++) {
+        if (*p == '%' || *p == '_' || *p == '\\') pattern[len++] = '\\';
+        pattern[len++] = *p;
+    }
+    pattern[len++] = '%';
+    pattern[len] = 0;
+    
+    char limit[16];
+    snprintf(limit, sizeof(limit), "%d", db_config.search_limit);
+    const char* params[3] = {term, pattern, limit};
+    
+    if (trigram_search) {
+        return execute_params_query(
+            "SELECT id, name, description, quantity, min_threshold, "
+            "unit, location, classification, checksum, "
+            "EXTRACT(EPOCH FROM last_updated), similarity(name, $1) AS score "
+            "FROM equipment WHERE name ILIKE $2 OR name % $1 "
+            "ORDER BY (name ILIKE $2) DESC, score DESC, id LIMIT $3",
+            3, params, PGRES_TUPLES_OK);
+    }
+    
+    return execute_params_query(
+        "SELECT id, name, description, quantity, min_threshold, "
+        "unit, location, classification, checksum, "
+        "EXTRACT(EPOCH FROM last_updated) "
+        "FROM equipment WHERE name ILIKE $1 ORDER BY id LIMIT $2",
+        2, params + 1, PGRES_TUPLES_OK);
+}
+
+// Keyset pagination: each page starts after the last ID shown, so the
+// cost of a page is independent of how deep into the table it is.
+// min_threshold is fetched alongside the listed columns to derive status.
+int send_equipment_page_query(int after_id) {
+    char after[16], limit[16];
+    snprintf(after, sizeof(after), "%d", after_id);
+    snprintf(limit, sizeof(limit), "%d", db_config.page_size);
+    const char* params[2] = {after, limit};
+    
+    db_conn_busy = PQsendQueryParams(db_conn,
+                                     "SELECT id, name, quantity, unit, location, min_threshold "
+                                     "FROM equipment WHERE id > $1 ORDER BY id LIMIT $2",
+                                     2, NULL, params, NULL, NULL, 0);
+    return db_conn_busy;
+}
+
+// Waits for a page sent by send_equipment_page_query()
+PGresult* receive_equipment_page(void) {
+    PGresult* res = await_result(db_conn);
+    db_conn_busy = 0;
+    
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(db_conn));
+        PQclear(res);
+        return NULL;
+    }
+    return res;
+}
+
+void equipment_from_page_row(Equipment* item, const PGresult* res, int row) {
+    memset(item, 0, sizeof(Equipment));
+    item->id = atoi(PQgetvalue(res, row, 0));
+    strncpy(item->name, PQgetvalue(res, row, 1), MAX_NAME_LEN - 1);
+    item->quantity = atoi(PQgetvalue(res, row, 2));
+    strncpy(item->unit, PQgetvalue(res, row, 3), MAX_UNIT_LEN - 1);
+    strncpy(item->location, PQgetvalue(res, row, 4), MAX_LOCATION_LEN - 1);
+    item->min_threshold = atoi(PQgetvalue(res, row, 5));
+}
+
+// ============================================================================
+// STARTUP PIPELINE
+// ============================================================================
+
+// Records the time since the previous mark under name
+void startup_phase(const char* name) {
+    long long now = now_us();
+    if (startup_phase_count < MAX_STARTUP_PHASES) {
+        startup_phases[startup_phase_count].name = name;
+        startup_phases[startup_phase_count].elapsed_us = now - startup_mark_us;
+        startup_phase_count++;
+    }
+    startup_mark_us = now;
+}
+
+void print_startup_timeline(void) {
+    printf(CYAN "⏱️  Startup %.1f ms:", (now_us() - startup_started_us) / 1000.0);
+    for (int i = 0; i < startup_phase_count; i++) {
+        printf("%s %s %.1f ms", i ? "," : "", startup_phases[i].name,
+               startup_phases[i].elapsed_us / 1000.0);
+    }
+    printf("\n" RESET);
+}
+
+int start_startup_stream(StartupStream* stream, const char* select_sql) {
+    char query[MAX_QUERY_LEN + 64];
+    format_untimed_read(query, sizeof(query), select_sql);
+    if (!stream->conn || !PQsendQuery(stream->conn, query)) return 0;
+    PQsetSingleRowMode(stream->conn);
+    return 1;
+}
+
+// Applies every row libpq has fully received. The load queries stop one
+// row past capacity, and that row is only counted, so truncation can be
+// reported.
+void drain_startup_stream(StartupStream* stream) {
+    if (!PQconsumeInput(stream->conn)) {
+        stream->failed = stream->done = 1;
+        return;
+    }
+    
+    while (!stream->done && !PQisBusy(stream->conn)) {
+        PGresult* res = PQgetResult(stream->conn);
+        if (!res) {
+            stream->done = 1;
+            break;
+        }
+        
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_SINGLE_TUPLE) {
+            stream->rows++;
+            stream->handler(res, 0, NULL);
+        } else if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
+            printf(RED "❌ Loading %s failed: %s" RESET, stream->name, PQresultErrorMessage(res));
+            stream->failed = 1;
+        }
+        PQclear(res);
+    }
+}
+
+int finish_request_load_stage(BackgroundJob* job) {
+    (void)job;
+    return 0;
+}
+
+void finish_request_load(BackgroundJob* job, int ok) {
+    if (!ok) {
+        printf(RED "\n❌ Loading supply requests failed.\n" RESET);
+    } else {
+        printf(GREEN "\n📋 Loaded %d supply requests in the background (%lld ms after startup).\n" RESET,
+               request_count, (now_us() - startup_started_us) / 1000);
+        if (request_count >= MAX_REQUESTS && job->rows > request_count) {
+            printf(YELLOW "⚠️  Warning: Database contains more requests than maximum. Truncating to %d.\n" RESET,
+                   MAX_REQUESTS);
+        }
+    }
+    fflush(stdout);
+}
+
+// Streams both tables at once on separate connections, inserting each
+// equipment row into the hash index as it arrives. The menu only needs
+// equipment, so a request load still running when that finishes is handed
+// to the background job runner and merges at the menu.
+void load_database_concurrently(void) {
+    char equipment_query[MAX_QUERY_LEN];
+    char request_query[MAX_QUERY_LEN];
+    format_equipment_load_query(equipment_query, sizeof(equipment_query));
+    format_request_load_query(request_query, sizeof(request_query));
+    
+    long rss_before = get_peak_rss_kb();
+    item_count = 0;
+    request_count = 0;
+    
+    StartupStream streams[2] = {
+        {"equipment", read_connection(), load_equipment_row, 0, 0, 0},
+        {"supply requests", bg_conn, load_request_row, 0, 0, 0},
+    };
+    StartupStream* equipment = &streams[0];
+    StartupStream* request_stream = &streams[1];
+    
+    if (!start_startup_stream(equipment, equipment_query)) {
+        load_equipment_from_db();
+        load_requests_from_db();
+        startup_phase("load");
+        return;
+    }
+    if (!start_startup_stream(request_stream, request_query)) {
+        request_stream->done = 1;
+        request_stream->conn = NULL;
+    }
+    
+    while (!equipment->done) {
+        struct pollfd fds[2];
+        int count = 0;
+        for (int i = 0; i < 2; i++) {
+            if (streams[i].done) continue;
+            fds[count++] = (struct pollfd){PQsocket(streams[i].conn), POLLIN, 0};
+        }
+        if (poll(fds, count, -1) < 0 && errno != EINTR) break;
+        
+        for (int i = 0; i < 2; i++) {
+            if (!streams[i].done) drain_startup_stream(&streams[i]);
+        }
+    }
+    startup_phase("equipment");
+    
+    if (equipment->failed) {
+        end_untimed_read(equipment->conn);
+        hash_clear();
+        item_count = 0;
+    }
+    if (item_count >= MAX_ITEMS && equipment->rows > item_count) {
+        printf(YELLOW "⚠️  Warning: Database contains more items than maximum. Truncating to %d.\n" RESET, MAX_ITEMS);
+    }
+    long rss_after = get_peak_rss_kb();
+    printf(GREEN "📊 Loaded %d equipment items from database.\n" RESET, item_count);
+    printf(CYAN "📈 Load memory: peak RSS %ld KB (+%ld KB during load, single-row streaming)\n" RESET,
+           rss_after, rss_after - rss_before);
+    
+    if (!request_stream->conn) {
+        load_requests_from_db();
+        startup_phase("requests");
+        return;
+    }
+    if (request_stream->done) {
+        if (request_stream->failed) end_untimed_read(request_stream->conn);
+        startup_phase("requests");
+        if (request_count >= MAX_REQUESTS && request_stream->rows > request_count) {
+            printf(YELLOW "⚠️  Warning: Database contains more requests than maximum. Truncating to %d.\n" RESET, MAX_REQUESTS);
+        }
+        printf(GREEN "📋 Loaded %d supply requests from database.\n" RESET, request_count);
+        return;
+    }
+    
+    BackgroundJob job = {0};
+    strcpy(job.label, "Request load");
+    job.active = 1;
+    job.mutates_store = 1;
+    job.conn = request_stream->conn;
+    job.send_stage = finish_request_load_stage;
+    job.on_row = load_request_row;
+    job.on_finish = finish_request_load;
+    job.rows = request_stream->rows;
+    job.started_ms = now_ms();
+    background_job = job;
+    printf(CYAN "⏳ Supply requests are still loading; %d so far.\n" RESET, request_count);
+}
+
+// ============================================================================
+// STORAGE ENGINES
+// ============================================================================
+
+static StorageStats memory_stats, file_stats, postgres_stats;
+static int file_dirty = 0;
+
+static void sqlite_close(void);
+
+// --- In-memory engine: no persistence, the working set is the store ---
+
+static int memory_open(void) {
+    memset(&memory_stats, 0, sizeof(memory_stats));
+    return 1;
+}
+
+static void memory_load(void) {
+    printf(YELLOW "🧪 In-memory storage: starting with an empty inventory.\n" RESET);
+}
+
+static int memory_insert_equipment(Equipment* item) {
+    (void)item;
+    memory_stats.inserts++;
+    return 1;
+}
+
+static int memory_update_equipment(const Equipment* item) {
+    (void)item;
+    memory_stats.updates++;
+    return 1;
+}
+
+static int memory_delete_equipment(int id) {
+    (void)id;
+    memory_stats.deletes++;
+    return 1;
+}
+
+static int memory_insert_request(SupplyRequest* req) {
+    (void)req;
+    memory_stats.inserts++;
+    return 1;
+}
+
+static int memory_scan_equipment(EquipmentVisitor visit, void* ctx) {
+    memory_stats.scans++;
+    int visited = 0;
+    for (int i = 0; i < item_count; i++) {
+        visited++;
+        if (!visit(&inventory[i], ctx)) break;
+    }
+    return visited;
+}
+
+static int memory_flush(void) {
+    memory_stats.flushes++;
+    return 1;
+}
+
+static void memory_engine_stats(StorageStats* out) {
+    *out = memory_stats;
+}
+
+static void memory_close(void) {
+}
+
+// --- Flat-file engine: whole-array snapshots rewritten on flush ---
+
+static int file_open(void) {
+    memset(&file_stats, 0, sizeof(file_stats));
+    file_dirty = 0;
+    return 1;
+}
+
+static void file_load(void) {
+    LoadStats stats;
+    int declared = load_equipment_file(db_config.data_file, 0, &stats);
+    if (declared >= 0) {
+        printf(GREEN "📁 Loaded %d equipment items from local files (%d thread%s).\n" RESET, item_count,
+               stats.threads, stats.threads == 1 ? "" : "s");
+        if (declared > item_count) {
+            printf(YELLOW "⚠️  Warning: %s declares %d items; only %d could be loaded.\n" RESET,
+                   db_config.data_file, declared, item_count);
+        }
+        report_checksum_mismatches(db_config.data_file, &stats);
+    }
+    
+    FILE* file = fopen(db_config.request_file, "rb");
+    if (file) {
+        fread(&request_count, sizeof(int), 1, file);
+        fread(&next_request_id, sizeof(int), 1, file);
+        fread(requests, sizeof(SupplyRequest), request_count, file);
+        fclose(file);
+        printf(GREEN "📋 Loaded %d supply requests from local files.\n" RESET, request_count);
+    }
+}
+
+static int file_insert_equipment(Equipment* item) {
+    (void)item;
+    file_stats.inserts++;
+    file_dirty = 1;
+    return 1;
+}
+
+static int file_update_equipment(const Equipment* item) {
+    (void)item;
+    file_stats.updates++;
+    file_dirty = 1;
+    return 1;
+}
+
+static int file_delete_equipment(int id) {
+    (void)id;
+    file_stats.deletes++;
+    file_dirty = 1;
+    return 1;
+}
+
+static int file_insert_request(SupplyRequest* req) {
+    (void)req;
+    file_stats.inserts++;
+    file_dirty = 1;
+    return 1;
+}
+
+static int file_flush(void) {
+    int ok = 1;
+    FILE* file = fopen(db_config.data_file, "wb");
+    if (file) {
+        fwrite(&item_count, sizeof(int), 1, file);
+        fwrite(&next_item_id, sizeof(int), 1, file);
+        fwrite(inventory, sizeof(Equipment), item_count, file);
+        fclose(file);
+        file_stats.bytes_written += 2 * sizeof(int) + item_count * sizeof(Equipment);
+    } else {
+        ok = 0;
+    }
+    
+    file = fopen(db_config.request_file, "wb");
+    if (file) {
+        fwrite(&request_count, sizeof(int), 1, file);
+        fwrite(&next_request_id, sizeof(int), 1, file);
+        fwrite(requests, sizeof(SupplyRequest), request_count, file);
+        fclose(file);
+        file_stats.bytes_written += 2 * sizeof(int) + request_count * sizeof(SupplyRequest);
+    } else {
+        ok = 0;
+    }
+    
+    file_stats.flushes++;
+    file_dirty = !ok;
+    return ok;
+}
+
+// Scans what is on disk, so pending changes are written out first
+static int file_scan_equipment(EquipmentVisitor visit, void* ctx) {
+    if (file_dirty) file_flush();
+    file_stats.scans++;
+    
+    FILE* file = fopen(db_config.data_file, "rb");
+    if (!file) return 0;
+    
+    int count = 0, skipped_id = 0, visited = 0;
+    fread(&count, sizeof(int), 1, file);
+    fread(&skipped_id, sizeof(int), 1, file);
+    
+    Equipment item;
+    while (visited < count && fread(&item, sizeof(Equipment), 1, file) == 1) {
+        visited++;
+        if (!visit(&item, ctx)) break;
+    }
+    fclose(file);
+    return visited;
+}
+
+static void file_engine_stats(StorageStats* out) {
+    *out = file_stats;
+}
+
+static void file_close(void) {
+    if (file_dirty) file_flush();
+}
+
+// --- PostgreSQL engine ---
+
+typedef struct {
+    EquipmentVisitor visit;
+    void* ctx;
+} PostgresScan;
+
+static int postgres_open(void) {
+    memset(&postgres_stats, 0, sizeof(postgres_stats));
+    return connect_database();
+}
+
+static void postgres_load(void) {
+    load_database_concurrently();
+}
+
+static int postgres_insert_equipment(Equipment* item) {
+    postgres_stats.inserts++;
+    int db_id = add_equipment_to_db(item);
+    if (db_id <= 0) return 0;
+    
+    item->id = db_id;
+    if (db_id >= next_item_id) {
+        next_item_id = db_id + 1;
+    }
+    return 1;
+}
+
+static int postgres_update_equipment(const Equipment* item) {
+    postgres_stats.updates++;
+    resync_note_local_write(item->id);
+    if (db_config.write_behind) {
+        write_behind_queue_update(item);
+        return 1;
+    }
+    return update_equipment_in_db(item);
+}
+
+static int postgres_delete_equipment(int id) {
+    postgres_stats.deletes++;
+    resync_note_local_write(id);
+    return delete_equipment_from_db(id);
+}
+
+static int postgres_insert_request(SupplyRequest* req) {
+    postgres_stats.inserts++;
+    int db_id = add_request_to_db(req);
+    if (db_id <= 0) return 0;
+    
+    req->req_id = db_id;
+    if (db_id >= next_request_id) {
+        next_request_id = db_id + 1;
+    }
+    return 1;
+}
+
+static int postgres_scan_row(const PGresult* res, int row, void* ctx) {
+    PostgresScan* scan = ctx;
+    Equipment item = {0};
+    equipment_from_row(&item, res, row);
+    return scan->visit(&item, scan->ctx);
+}
+
+static int postgres_scan_equipment(EquipmentVisitor visit, void* ctx) {
+    postgres_stats.scans++;
+    write_behind_flush();
+    
+    PostgresScan scan = {visit, ctx};
+    return stream_read_query("equipment_scan_cur",
+                             "SELECT id, name, description, quantity, min_threshold, "
+                             "unit, location, classification, checksum, "
+                             "EXTRACT(EPOCH FROM last_updated) FROM equipment ORDER BY id",
+                             postgres_scan_row, &scan);
+}
+
+static int postgres_flush(void) {
+    postgres_stats.flushes++;
+    return write_behind_flush();
+}
+
+static void postgres_engine_stats(StorageStats* out) {
+    *out = postgres_stats;
+}
+
+static void postgres_close(void) {
+    if (bg_conn) {
+        PQfinish(bg_conn);
+        bg_conn = NULL;
+    }
+    if (read_conn) {
+        PQfinish(read_conn);
+        read_conn = NULL;
+    }
+    if (!db_conn) return;
+    write_behind_flush();
+    PQfinish(db_conn);
+    db_conn = NULL;
+}
+
+// --- SQLite engine: embedded, WAL-journaled, prepared statements ---
+
+static sqlite3* sqlite_db = NULL;
+static sqlite3_stmt* sqlite_insert_equipment_stmt = NULL;
+static sqlite3_stmt* sqlite_update_equipment_stmt = NULL;
+static sqlite3_stmt* sqlite_delete_equipment_stmt = NULL;
+static sqlite3_stmt* sqlite_insert_request_stmt = NULL;
+static sqlite3_stmt* sqlite_scan_stmt = NULL;
+static StorageStats sqlite_stats;
+static int sqlite_pending_writes = 0;
+
+static int sqlite_check(int rc, const char* what) {
+    if (rc == SQLITE_OK || rc == SQLITE_DONE || rc == SQLITE_ROW) return 1;
+    printf(RED "❌ SQLite %s failed: %s\n" RESET, what, sqlite3_errmsg(sqlite_db));
+    return 0;
+}
+
+// Some errors (disk full, I/O) make SQLite abandon the whole open
+// transaction, and the writes already reported as done with it
+static void sqlite_check_batch_lost(void) {
+    if (sqlite_pending_writes == 0 || !sqlite3_get_autocommit(sqlite_db)) return;
+    char message[MAX_LOG_MSG_LEN];
+    snprintf(message, sizeof(message),
+             "SQLite rolled back a batch: %d earlier write(s) were lost", sqlite_pending_writes);
+    printf(RED "❌ %s\n" RESET, message);
+    log_event(LOG_CRITICAL, message);
+    sqlite_pending_writes = 0;
+}
+
+// A COMMIT that fails with the transaction still open (SQLITE_BUSY, for
+// one) keeps the batch pending, so the next write joins it and the next
+// commit or flush retries
+static int sqlite_commit(void) {
+    if (sqlite_pending_writes == 0) return 1;
+    sqlite_stats.flushes++;
+    if (sqlite_check(sqlite3_exec(sqlite_db, "COMMIT", NULL, NULL, NULL), "commit")) {
+        sqlite_pending_writes = 0;
+        return 1;
+    }
+    sqlite_check_batch_lost();
+    return 0;
+}
+
+// Writes join an open transaction that commits every sqlite_batch_size
+// writes, so bulk work pays one WAL sync per batch instead of per row.
+// Earlier writes in the batch have already been reported as done, so each
+// later one runs under a savepoint and a failure undoes only itself.
+static int sqlite_begin_write(void) {
+    if (sqlite_pending_writes == 0) {
+        return sqlite_check(sqlite3_exec(sqlite_db, "BEGIN IMMEDIATE", NULL, NULL, NULL), "begin");
+    }
+    return sqlite_check(sqlite3_exec(sqlite_db, "SAVEPOINT batch_write", NULL, NULL, NULL), "savepoint");
+}
+
+static int sqlite_end_write(int rc, sqlite3_stmt* stmt, const char* what) {
+    sqlite3_reset(stmt);
+    if (!sqlite_check(rc, what)) {
+        if (sqlite_pending_writes == 0) {
+            sqlite3_exec(sqlite_db, "ROLLBACK", NULL, NULL, NULL);
+            return 0;
+        }
+        sqlite3_exec(sqlite_db, "ROLLBACK TO batch_write; RELEASE batch_write", NULL, NULL, NULL);
+        sqlite_check_batch_lost();
+        return 0;
+    }
+    
+    if (sqlite_pending_writes > 0 &&
+        !sqlite_check(sqlite3_exec(sqlite_db, "RELEASE batch_write", NULL, NULL, NULL), "release")) {
+        return 0;
+    }
+    sqlite_pending_writes++;
+    if (sqlite_pending_writes >= db_config.sqlite_batch_size) {
+        // This write is only lost if the whole batch was
+        return sqlite_commit() || sqlite_pending_writes > 0;
+    }
+    return 1;
+}
+
+static int sqlite_open(void) {
+    memset(&sqlite_stats, 0, sizeof(sqlite_stats));
+    sqlite_pending_writes = 0;
+    
+    if (sqlite3_open_v2(db_config.db_path, &sqlite_db,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+        printf(YELLOW "⚠️  Warning: SQLite open failed: %s\n" RESET, sqlite3_errmsg(sqlite_db));
+        sqlite3_close(sqlite_db);
+        sqlite_db = NULL;
+        return 0;
+    }
+    sqlite3_busy_timeout(sqlite_db, 2000);
+    
+    char pragmas[256];
+    snprintf(pragmas, sizeof(pragmas),
+             "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL; "
+             "PRAGMA mmap_size=%lld; PRAGMA temp_store=MEMORY;",
+             db_config.sqlite_mmap_size);
+    
+    const char* schema =
+        "CREATE TABLE IF NOT EXISTS equipment ("
+        "  id INTEGER PRIMARY KEY,"
+        "  name TEXT NOT NULL,"
+        "  description TEXT NOT NULL DEFAULT '',"
+        "  quantity INTEGER NOT NULL DEFAULT 0,"
+        "  min_threshold INTEGER NOT NULL DEFAULT 0,"
+        "  unit TEXT NOT NULL DEFAULT 'ea',"
+        "  location TEXT NOT NULL DEFAULT '',"
+        "  classification INTEGER NOT NULL DEFAULT 0,"
+        "  checksum TEXT NOT NULL DEFAULT '',"
+        "  last_updated INTEGER NOT NULL);"
+        "CREATE TABLE IF NOT EXISTS supply_requests ("
+        "  req_id INTEGER PRIMARY KEY,"
+        "  equipment_id INTEGER NOT NULL,"
+        "  requested_qty INTEGER NOT NULL,"
+        "  requesting_unit TEXT NOT NULL,"
+        "  request_time INTEGER NOT NULL,"
+        "  status INTEGER NOT NULL DEFAULT 0,"
+        "  priority INTEGER NOT NULL DEFAULT 2);"
+        "CREATE INDEX IF NOT EXISTS equipment_name_idx ON equipment (name);"
+        "CREATE INDEX IF NOT EXISTS equipment_location_idx ON equipment (location);";
+    
+    int ok = sqlite_check(sqlite3_exec(sqlite_db, pragmas, NULL, NULL, NULL), "configure") &&
+             sqlite_check(sqlite3_exec(sqlite_db, schema, NULL, NULL, NULL), "schema setup");
+    
+    ok = ok && sqlite_check(sqlite3_prepare_v2(sqlite_db,
+        "INSERT INTO equipment (id, name, description, quantity, min_threshold, unit, "
+        "location, classification, checksum, last_updated) VALUES (?,?,?,?,?,?,?,?,?,?)",
+        -1, &sqlite_insert_equipment_stmt, NULL), "prepare");
+    ok = ok && sqlite_check(sqlite3_prepare_v2(sqlite_db,
+        "UPDATE equipment SET quantity = ?, checksum = ?, last_updated = ? WHERE id = ?",
+        -1, &sqlite_update_equipment_stmt, NULL), "prepare");
+    ok = ok && sqlite_check(sqlite3_prepare_v2(sqlite_db,
+        "DELETE FROM equipment WHERE id = ?",
+        -1, &sqlite_delete_equipment_stmt, NULL), "prepare");
+    ok = ok && sqlite_check(sqlite3_prepare_v2(sqlite_db,
+        "INSERT INTO supply_requests (req_id, equipment_id, requested_qty, requesting_unit, "
+        "request_time, status, priority) VALUES (?,?,?,?,?,?,?)",
+        -1, &sqlite_insert_request_stmt, NULL), "prepare");
+    ok = ok && sqlite_check(sqlite3_prepare_v2(sqlite_db,
+        "SELECT id, name, description, quantity, min_threshold, unit, location, "
+        "classification, checksum, last_updated FROM equipment ORDER BY id",
+        -1, &sqlite_scan_stmt, NULL), "prepare");
+    
+    if (!ok) {
+        sqlite_close();
+        return 0;
+    }
+    
+    printf(GREEN "✅ Opened SQLite database '%s' (WAL).\n" RESET, db_config.db_path);
+    return 1;
+}
+
+static void equipment_from_sqlite(Equipment* item, sqlite3_stmt* stmt) {
+    memset(item, 0, sizeof(Equipment));
+    item->id = sqlite3_column_int(stmt, 0);
+    strncpy(item->name, (const char*)sqlite3_column_text(stmt, 1), MAX_NAME_LEN - 1);
+    strncpy(item->description, (const char*)sqlite3_column_text(stmt, 2), MAX_DESC_LEN - 1);
+    item->quantity = sqlite3_column_int(stmt, 3);
+    item->min_threshold = sqlite3_column_int(stmt, 4);
+    strncpy(item->unit, (const char*)sqlite3_column_text(stmt, 5), MAX_UNIT_LEN - 1);
+    strncpy(item->location, (const char*)sqlite3_column_text(stmt, 6), MAX_LOCATION_LEN - 1);
+    item->classification = sqlite3_column_int(stmt, 7);
+    strncpy(item->checksum, (const char*)sqlite3_column_text(stmt, 8), 15);
+    item->last_updated = (time_t)sqlite3_column_int64(stmt, 9);
+}
+
+static void sqlite_load(void) {
+    item_count = 0;
+    while (sqlite3_step(sqlite_scan_stmt) == SQLITE_ROW && item_count < MAX_ITEMS) {
+        Equipment* item = &inventory[item_count++];
+        equipment_from_sqlite(item, sqlite_scan_stmt);
+        hash_insert(item);
+        if (item->id >= next_item_id) next_item_id = item->id + 1;
+    }
+    sqlite3_reset(sqlite_scan_stmt);
+    
+    sqlite3_stmt* stmt;
+    request_count = 0;
+    if (sqlite3_prepare_v2(sqlite_db,
+            "SELECT req_id, equipment_id, requested_qty, requesting_unit, request_time, "
+            "status, priority FROM supply_requests ORDER BY req_id",
+            -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW && request_count < MAX_REQUESTS) {
+            SupplyRequest* req = &requests[request_count++];
+            memset(req, 0, sizeof(SupplyRequest));
+            req->req_id = sqlite3_column_int(stmt, 0);
+            req->equipment_id = sqlite3_column_int(stmt, 1);
+            req->requested_qty = sqlite3_column_int(stmt, 2);
+            strncpy(req->requesting_unit, (const char*)sqlite3_column_text(stmt, 3), MAX_UNIT_LEN - 1);
+            req->request_time = (time_t)sqlite3_column_int64(stmt, 4);
+            req->status = sqlite3_column_int(stmt, 5);
+            req->priority = sqlite3_column_int(stmt, 6);
+            if (req->req_id >= next_request_id) next_request_id = req->req_id + 1;
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    printf(GREEN "📊 Loaded %d equipment items and %d supply requests from SQLite.\n" RESET,
+           item_count, request_count);
+}
+
+static int sqlite_insert_equipment(Equipment* item) {
+    sqlite_stats.inserts++;
+    if (!sqlite_begin_write()) return 0;
+    
+    sqlite3_stmt* stmt = sqlite_insert_equipment_stmt;
+    sqlite3_bind_int(stmt, 1, item->id);
+    sqlite3_bind_text(stmt, 2, item->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, item->description, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, item->quantity);
+    sqlite3_bind_int(stmt, 5, item->min_threshold);
+    sqlite3_bind_text(stmt, 6, item->unit, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, item->location, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 8, item->classification);
+    sqlite3_bind_text(stmt, 9, item->checksum, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 10, item->last_updated);
+    return sqlite_end_write(sqlite3_step(stmt), stmt, "insert");
+}
+
+static int sqlite_update_equipment(const Equipment* item) {
+    sqlite_stats.updates++;
+    if (!sqlite_begin_write()) return 0;
+    
+    sqlite3_stmt* stmt = sqlite_update_equipment_stmt;
+    sqlite3_bind_int(stmt, 1, item->quantity);
+    sqlite3_bind_text(stmt, 2, item->checksum, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, item->last_updated);
+    sqlite3_bind_int(stmt, 4, item->id);
+    return sqlite_end_write(sqlite3_step(stmt), stmt, "update");
+}
+
+static int sqlite_delete_equipment(int id) {
+    sqlite_stats.deletes++;
+    if (!sqlite_begin_write()) return 0;
+    
+    sqlite3_stmt* stmt = sqlite_delete_equipment_stmt;
+    sqlite3_bind_int(stmt, 1, id);
+    return sqlite_end_write(sqlite3_step(stmt), stmt, "delete");
+}
+
+static int sqlite_insert_request(SupplyRequest* req) {
+    sqlite_stats.inserts++;
+    if (!sqlite_begin_write()) return 0;
+    
+    sqlite3_stmt* stmt = sqlite_insert_request_stmt;
+    sqlite3_bind_int(stmt, 1, req->req_id);
+    sqlite3_bind_int(stmt, 2, req->equipment_id);
+    sqlite3_bind_int(stmt, 3, req->requested_qty);
+    sqlite3_bind_text(stmt, 4, req->requesting_unit, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 5, req->request_time);
+    sqlite3_bind_int(stmt, 6, req->status);
+    sqlite3_bind_int(stmt, 7, req->priority);
+    return sqlite_end_write(sqlite3_step(stmt), stmt, "insert");
+}
+
+static int sqlite_scan_equipment(EquipmentVisitor visit, void* ctx) {
+    sqlite_stats.scans++;
+    
+    int visited = 0;
+    Equipment item;
+    while (sqlite3_step(sqlite_scan_stmt) == SQLITE_ROW) {
+        equipment_from_sqlite(&item, sqlite_scan_stmt);
+        visited++;
+        if (!visit(&item, ctx)) break;
+    }
+    sqlite3_reset(sqlite_scan_stmt);
+    return visited;
+}
+
+static int sqlite_flush(void) {
+    return sqlite_commit();
+}
+
+static void sqlite_engine_stats(StorageStats* out) {
+    *out = sqlite_stats;
+}
+
+static void sqlite_close(void) {
+    if (!sqlite_db) return;
+    if (!sqlite_commit() && sqlite_pending_writes > 0) {
+        char message[MAX_LOG_MSG_LEN];
+        snprintf(message, sizeof(message), "SQLite commit failed at close: %d write(s) were lost",
+                 sqlite_pending_writes);
+        printf(RED "❌ %s\n" RESET, message);
+        log_event(LOG_CRITICAL, message);
+        sqlite3_exec(sqlite_db, "ROLLBACK", NULL, NULL, NULL);
+        sqlite_pending_writes = 0;
+    }
+    
+    sqlite3_stmt** statements[] = {
+        &sqlite_insert_equipment_stmt, &sqlite_update_equipment_stmt,
+        &sqlite_delete_equipment_stmt, &sqlite_insert_request_stmt, &sqlite_scan_stmt
+    };
+    for (size_t i = 0; i < sizeof(statements) / sizeof(statements[0]); i++) {
+        sqlite3_finalize(*statements[i]);
+        *statements[i] = NULL;
+    }
+    sqlite3_close(sqlite_db);
+    sqlite_db = NULL;
+}
+
+const StorageEngine MEMORY_ENGINE = {
+    "memory", "In-Memory Storage (not persisted)",
+    memory_open, memory_load, memory_insert_equipment, memory_update_equipment,
+    memory_delete_equipment, memory_insert_request, memory_scan_equipment,
+    memory_flush, memory_engine_stats, memory_close
+};
+
+const StorageEngine FILE_ENGINE = {
+    "file", "Local File Storage",
+    file_open, file_load, file_insert_equipment, file_update_equipment,
+    file_delete_equipment, file_insert_request, file_scan_equipment,
+    file_flush, file_engine_stats, file_close
+};
+
+const StorageEngine POSTGRES_ENGINE = {
+    "postgres", "PostgreSQL Database",
+    postgres_open, postgres_load, postgres_insert_equipment, postgres_update_equipment,
+    postgres_delete_equipment, postgres_insert_request, postgres_scan_equipment,
+    postgres_flush, postgres_engine_stats, postgres_close
+};
+
+const StorageEngine SQLITE_ENGINE = {
+    "sqlite", "Embedded SQLite (WAL)",
+    sqlite_open, sqlite_load, sqlite_insert_equipment, sqlite_update_equipment,
+    sqlite_delete_equipment, sqlite_insert_request, sqlite_scan_equipment,
+    sqlite_flush, sqlite_engine_stats, sqlite_close
+};
+
+static const StorageEngine* const STORAGE_ENGINES[] = {
+    &MEMORY_ENGINE, &FILE_ENGINE, &SQLITE_ENGINE, &POSTGRES_ENGINE
+};
+
+#define STORAGE_ENGINE_COUNT (int)(sizeof(STORAGE_ENGINES) / sizeof(STORAGE_ENGINES[0]))
+
+const StorageEngine* find_storage_engine(const char* name) {
+    for (int i = 0; i < STORAGE_ENGINE_COUNT; i++) {
+        if (strcmp(STORAGE_ENGINES[i]->name, name) == 0) {
+            return STORAGE_ENGINES[i];
+        }
+    }
+    return NULL;
+}
+
+// Opens the configured engine, falling back to local files when it is
+// unknown or unreachable, and loads the working set from it
+void open_storage(void) {
+    load_db_config();
+    startup_phase("config");
+    
+    storage = find_storage_engine(db_config.storage_engine);
+    if (!storage) {
+        printf(YELLOW "⚠️  Warning: Unknown storage engine '%s'. Using local files.\n" RESET,
+               db_config.storage_engine);
+        storage = &FILE_ENGINE;
+    }
+    
+    if (!storage->open()) {
+        char message[MAX_LOG_MSG_LEN];
+        snprintf(message, sizeof(message), "Storage engine %s unavailable; using local files",
+                 storage->name);
+        storage = &FILE_ENGINE;
+        storage->open();
+        log_event(LOG_WARNING, message);
+    }
+    
+    use_database = storage == &POSTGRES_ENGINE;
+    startup_phase("open");
+    storage->load();
+    if (!use_database) startup_phase("load");
+}
+
+void close_storage(void) {
+    if (!storage) return;
+    storage->flush();
+    storage->close();
+    storage = NULL;
+}
+
+// ============================================================================
+// ENHANCED CORE FUNCTIONALITY
+// ============================================================================
+
+void display_menu(void) {
+    display_banner();
+    
+    printf(BOLD WHITE "🎯 MISSION COMMANDS:\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    printf(GREEN "  [1]" WHITE " 📦 Add Equipment          " GREEN "[2]" WHITE " 🔍 Check Inventory\n");
+    printf(GREEN "  [3]" WHITE " 📋 List All Equipment     " GREEN "[4]" WHITE " 📊 Update Quantity\n");
+    printf(GREEN "  [5]" WHITE " 📝 Request Supply         " GREEN "[6]" WHITE " 📑 Check Requests\n");
+    printf(GREEN "  [7]" WHITE " 🚨 Low Stock Alert        " GREEN "[8]" WHITE " 📄 Export Report\n");
+    printf(GREEN "  [9]" WHITE " 🚪 Exit System            " GREEN "[10]" WHITE " 🔄 Resync Database\n");
+    printf(GREEN "  [11]" WHITE " 📈 Query Statistics       " GREEN "[12]" WHITE " 💾 Hot Backup\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    display_command_prompt();
+}
+
+void add_equipment(void) {
+    display_banner();
+    printf(BOLD YELLOW "📦 ADD NEW EQUIPMENT\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (item_count >= MAX_ITEMS) {
+        printf(RED "❌ ERROR: Maximum equipment limit reached.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    Equipment* item = &inventory[item_count];
+    item->id = next_item_id++;
+    
+    get_string_input("Equipment Name: ", item->name, MAX_NAME_LEN);
+    get_string_input("Description: ", item->description, MAX_DESC_LEN);
+    
+    item->quantity = get_int_input("Initial Quantity: ", 0, 999999);
+    item->min_threshold = get_int_input("Minimum Threshold: ", 0, 999999);
+    
+    get_string_input("Unit (ea, box, case, etc.): ", item->unit, MAX_UNIT_LEN);
+    get_string_input("Location: ", item->location, MAX_LOCATION_LEN);
+    
+    item->classification = get_int_input(
+        "Classification (0=Unclass, 1=Restricted, 2=Confidential, 3=Secret): ", 
+        0, 3);
+    
+    item->last_updated = time(NULL);
+    sprintf(item->checksum, "%04d", calculate_checksum(item));
+    
+    storage->insert_equipment(item);
+    
+    hash_insert(item);
+    item_count++;
+    
+    audit_add_equipment(item);
+    
+    printf(GREEN "\n✅ Equipment added successfully. ID: %d\n" RESET, item->id);
+    wait_for_enter();
+}
+
+void check_inventory(const char* item_name) {
+    display_banner();
+    printf(BOLD YELLOW "🔍 INVENTORY SEARCH RESULTS\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (use_database) {
+        write_behind_flush();
+        PGresult* res = search_equipment_in_db(item_name);
+        if (res) {
+            int matches = PQntuples(res);
+            for (int r = 0; r < matches; r++) {
+                Equipment match;
+                memset(&match, 0, sizeof(match));
+                equipment_from_row(&match, res, r);
+                display_equipment_details(&match);
+                printf("\n");
+            }
+            PQclear(res);
+            
+            if (matches == 0) {
+                printf(RED "❌ No equipment found matching '%s'\n" RESET, item_name);
+            } else if (matches == db_config.search_limit) {
+                printf(CYAN "Showing the top %d matches.\n" RESET, matches);
+            }
+            wait_for_enter();
+            return;
+        }
+        printf(YELLOW "⚠️  Database search failed; searching the local copy.\n" RESET);
+    }
+    
+    Equipment* item = hash_find(item_name);
+    if (item) {
+        display_equipment_details(item);
+    } else {
+        int found = 0;
+        for (int i = 0; i < item_count; i++) {
+            if (strcasestr(inventory[i].name, item_name)) {
+                display_equipment_details(&inventory[i]);
+                found = 1;
+                printf("\n");
+            }
+        }
+        if (!found) {
+            printf(RED "❌ No equipment found matching '%s'\n" RESET, item_name);
+        }
+    }
+    wait_for_enter();
+}
+
+// Browses the database a page at a time. The next page is requested as
+// soon as the current one is shown, so it is usually ready by the time
+// the operator asks for it.
+void list_equipment_pages(void) {
+    if (!send_equipment_page_query(0)) {
+        printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(db_conn));
+        wait_for_enter();
+        return;
+    }
+    
+    PGresult* page = receive_equipment_page();
+    int page_number = 1, shown = 0;
+    
+    while (page) {
+        int rows = PQntuples(page);
+        if (rows == 0) {
+            PQclear(page);
+            if (page_number == 1) {
+                printf(YELLOW "⚠️  No equipment in inventory.\n" RESET);
+            } else {
+                printf(CYAN "End of inventory — %d items listed.\n" RESET, shown);
+            }
+            wait_for_enter();
+            return;
+        }
+        
+        display_equipment_table_header();
+        Equipment item;
+        for (int r = 0; r < rows; r++) {
+            equipment_from_page_row(&item, page, r);
+            display_equipment_row(&item);
+        }
+        printf("└──────┴──────────────────────┴──────────┴────────┴─────────────────┴────────────┘\n");
+        
+        int last_id = item.id;
+        int more = rows == db_config.page_size;
+        PQclear(page);
+        page = NULL;
+        shown += rows;
+        printf(BOLD CYAN "Page %d — items %d-%d\n" RESET, page_number, shown - rows + 1, shown);
+        
+        if (!more) {
+            wait_for_enter();
+            break;
+        }
+        
+        int prefetching = send_equipment_page_query(last_id);
+        
+        char answer[8];
+        get_string_input("[N]ext page / [Q]uit: ", answer, sizeof(answer));
+        if (tolower((unsigned char)answer[0]) == 'q') {
+            if (prefetching) {
+                page = receive_equipment_page();
+                PQclear(page);
+            }
+            break;
+        }
+        
+        if (!prefetching) {
+            printf(RED "❌ Database query failed: %s\n" RESET, PQerrorMessage(db_conn));
+            wait_for_enter();
+            break;
+        }
+        page = receive_equipment_page();
+        page_number++;
+        display_banner();
+        printf(BOLD YELLOW "📋 COMPLETE INVENTORY LISTING\n" RESET);
+        printf("════════════════════════════════════════════════════════════════════════════════\n");
+    }
+}
+
+void list_all_equipment(void) {
+    display_banner();
+    printf(BOLD YELLOW "📋 COMPLETE INVENTORY LISTING\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (use_database) {
+        write_behind_flush();
+        list_equipment_pages();
+        return;
+    }
+    
+    if (item_count == 0) {
+        printf(YELLOW "⚠️  No equipment in inventory.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    display_equipment_table_header();
+    
+    for (int i = 0; i < item_count; i++) {
+        display_equipment_row(&inventory[i]);
+    }
+    
+    display_equipment_table_footer(item_count);
+    wait_for_enter();
+}
+
+void update_quantity(void) {
+    display_banner();
+    printf(BOLD YELLOW "📊 UPDATE EQUIPMENT QUANTITY\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    int id = get_int_input("Equipment ID: ", 1, 999999);
+    Equipment* item = find_by_id(id);
+    
+    if (!item) {
+        printf(RED "❌ Equipment ID not found.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    printf(CYAN "Current quantity: " WHITE "%d %s\n" RESET, item->quantity, item->unit);
+    int old_qty = item->quantity;
+    item->quantity = get_int_input("New quantity: ", 0, 999999);
+    
+    item->last_updated = time(NULL);
+    sprintf(item->checksum, "%04d", calculate_checksum(item));
+    
+    storage->update_equipment(item);
+    
+    audit_update_quantity(item, old_qty);
+    
+    printf(GREEN "\n✅ Quantity updated successfully.\n" RESET);
+    wait_for_enter();
+}
+
+void request_supply(void) {
+    display_banner();
+    printf(BOLD YELLOW "📝 CREATE SUPPLY REQUEST\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (request_count >= MAX_REQUESTS) {
+        printf(RED "❌ ERROR: Maximum request limit reached.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    SupplyRequest* req = &requests[request_count];
+    req->req_id = next_request_id++;
+    
+    req->equipment_id = get_int_input("Equipment ID: ", 1, 999999);
+    
+    Equipment* item = find_by_id(req->equipment_id);
+    if (!item) {
+        printf(RED "❌ Equipment ID not found.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    printf(GREEN "Requesting: " WHITE "%s\n" RESET, item->name);
+    req->requested_qty = get_int_input("Quantity needed: ", 1, 999999);
+    
+    get_string_input("Requesting unit: ", req->requesting_unit, MAX_UNIT_LEN);
+    
+    req->priority = get_int_input(
+        "Priority (1=Low, 2=Normal, 3=High, 4=Critical): ", 1, 4);
+    
+    req->request_time = time(NULL);
+    req->status = REQ_PENDING;
+    
+    storage->insert_request(req);
+    
+    request_count++;
+    
+    audit_supply_request(req);
+    
+    printf(GREEN "\n✅ Supply request submitted. Request ID: REQ-%d\n" RESET, req->req_id);
+    wait_for_enter();
+}
+
+void check_requests(void) {
+    display_banner();
+    printf(BOLD YELLOW "📑 SUPPLY REQUEST STATUS\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (request_count == 0) {
+        printf(YELLOW "⚠️  No supply requests on file.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    printf(BOLD WHITE);
+    printf("┌──────────┬──────────┬──────────────┬─────────┬──────────────┬────────────┐\n");
+    printf("│ %-8s │ %-8s │ %-12s │ %-7s │ %-12s │ %-10s │\n",
+           "REQ-ID", "EQUIP-ID", "UNIT", "QTY", "PRIORITY", "STATUS");
+    printf("├──────────┼──────────┼──────────────┼─────────┼──────────────┼────────────┤\n");
+    printf(RESET);
+    
+    for (int i = 0; i < request_count; i++) {
+        SupplyRequest* req = &requests[i];
+        const char* status_color = (req->status == REQ_PENDING) ? YELLOW :
+                                  (req->status == REQ_APPROVED) ? GREEN :
+                                  (req->status == REQ_FULFILLED) ? BLUE : RED;
+        
+        printf("│ %-8d │ %-8d │ %-12s │ %-7d │ %-12s │ %s%-10s%s │\n",
+               req->req_id, req->equipment_id, req->requesting_unit,
+               req->requested_qty, PRIORITY_NAMES[req->priority],
+               status_color, STATUS_NAMES[req->status], RESET);
+    }
+    
+    printf("└──────────┴──────────┴──────────────┴─────────┴──────────────┴────────────┘\n");
+    printf(BOLD CYAN "Total Supply Requests: %d\n" RESET, request_count);
+    wait_for_enter();
+}
+
+void display_low_stock_entry(int id, const char* name, int quantity,
+                             int min_threshold, const char* location) {
+    printf(BOLD RED "🚨 CRITICAL: " WHITE "%s (ID: %d)\n" RESET, name, id);
+    printf(CYAN "    Current: " WHITE "%d" CYAN ", Minimum: " WHITE "%d\n" RESET,
+           quantity, min_threshold);
+    printf(CYAN "    Location: " WHITE "%s\n\n" RESET, location);
+}
+
+int display_low_stock_row(const PGresult* res, int row, void* ctx) {
+    (void)ctx;
+    display_low_stock_entry(atoi(PQgetvalue(res, row, 0)), PQgetvalue(res, row, 1),
+                            atoi(PQgetvalue(res, row, 2)), atoi(PQgetvalue(res, row, 3)),
+                            PQgetvalue(res, row, 4));
+    return 1;
+}
+
+int reports_pushed_down(void) {
+    return use_database && db_config.report_pushdown;
+}
+
+void low_stock_alert(void) {
+    display_banner();
+    printf(BOLD RED "🚨 LOW STOCK ALERT\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    printf(BOLD WHITE "Equipment requiring immediate attention:\n\n" RESET);
+    
+    int alerts = 0;
+    
+    if (reports_pushed_down()) {
+        alerts = stream_low_stock_from_db(display_low_stock_row, NULL);
+        if (alerts < 0) {
+            printf(RED "❌ Low stock query failed.\n" RESET);
+            wait_for_enter();
+            return;
+        }
+    } else {
+        for (int i = 0; i < item_count; i++) {
+            if (get_stock_status(&inventory[i]) == STATUS_LOW) {
+                display_low_stock_entry(inventory[i].id, inventory[i].name,
+                                        inventory[i].quantity, inventory[i].min_threshold,
+                                        inventory[i].location);
+                alerts++;
+            }
+        }
+    }
+    
+    if (alerts == 0) {
+        printf(GREEN "✅ All equipment levels are adequate.\n" RESET);
+    } else {
+        printf(BOLD RED "⚠️  Total items requiring resupply: %d\n" RESET, alerts);
+    }
+    
+    wait_for_enter();
+}
+
+void summarize_inventory_locally(InventorySummary* summary) {
+    memset(summary, 0, sizeof(InventorySummary));
+    for (int i = 0; i < item_count; i++) {
+        int classification = inventory[i].classification;
+        if (classification < 0) classification = 0;
+        if (classification > 3) classification = 3;
+        StockStatus status = get_stock_status(&inventory[i]);
+        summary->items[classification][status]++;
+        summary->quantity[classification][status] += inventory[i].quantity;
+    }
+}
+
+int write_report_row(const Equipment* item, void* ctx) {
+    FILE* report = ctx;
+    int classification = item->classification < 0 ? 0 :
+                         item->classification > 3 ? 3 : item->classification;
+    fprintf(report, "ID: %d | %s | Qty: %d %s | Location: %s | Status: %s | Class: %s\n",
+            item->id, item->name, item->quantity, item->unit, 
+            item->location, STOCK_STATUS_NAMES[get_stock_status(item)],
+            CLASS_NAMES[classification]);
+    return 1;
+}
+
+void write_report_header(FILE* report, const InventorySummary* summary) {
+    int total = 0, low_stock = 0;
+    for (int c = 0; c < 4; c++) {
+        for (int st = 0; st < 3; st++) total += summary->items[c][st];
+        low_stock += summary->items[c][STATUS_LOW];
+    }
+    
+    time_t now = time(NULL);
+    fprintf(report, "TACTICAL SUPPLY INVENTORY REPORT\n");
+    fprintf(report, "Generated: %s", ctime(&now));
+    fprintf(report, "Data Source: %s\n", storage->description);
+    fprintf(report, "================================\n\n");
+    
+    fprintf(report, "INVENTORY SUMMARY:\n");
+    fprintf(report, "Total Items: %d\n", total);
+    fprintf(report, "Items requiring resupply: %d\n\n", low_stock);
+    
+    fprintf(report, "STATUS BY CLASSIFICATION:\n");
+    for (int c = 0; c < 4; c++) {
+        fprintf(report, "%-13s", CLASS_NAMES[c]);
+        for (int st = 0; st < 3; st++) {
+            fprintf(report, " | %s: %d items, %lld units", STOCK_STATUS_NAMES[st],
+                    summary->items[c][st], summary->quantity[c][st]);
+        }
+        fprintf(report, "\n");
+    }
+    fprintf(report, "\n");
+    
+    fprintf(report, "DETAILED INVENTORY:\n");
+}
+
+// State of a report export running on the background connection
+typedef struct {
+    FILE* report;
+    InventorySummary summary;
+    long detail_rows;
+} ExportJob;
+
+ExportJob export_job;
+
+int export_detail_row(const PGresult* res, int row, void* ctx) {
+    export_job.detail_rows++;
+    Equipment item = {0};
+    equipment_from_row(&item, res, row);
+    return write_report_row(&item, ctx);
+}
+
+// Stage 0 computes the summary, stage 1 streams the detail listing once
+// the header has been written
+int send_export_stage(BackgroundJob* job) {
+    if (job->stage == 0) {
+        job->on_row = summary_from_row;
+        job->ctx = &export_job.summary;
+        return send_background_query(SQL_INVENTORY_SUMMARY);
+    }
+    if (job->stage == 1) {
+        write_report_header(export_job.report, &export_job.summary);
+        job->on_row = export_detail_row;
+        job->ctx = export_job.report;
+        return send_background_query(
+            "SELECT id, name, description, quantity, min_threshold, "
+            "unit, location, classification, checksum, "
+            "EXTRACT(EPOCH FROM last_updated) FROM equipment ORDER BY id");
+    }
+    return 0;
+}
+
+void finish_export(BackgroundJob* job, int ok) {
+    if (!ok) {
+        fprintf(export_job.report, "(report incomplete: database query failed)\n");
+    }
+    fclose(export_job.report);
+    export_job.report = NULL;
+    
+    if (ok) {
+        printf(GREEN "\n✅ Report exported to 'inventory_report.txt' (%ld rows, %lld ms)\n" RESET,
+               job->rows, now_ms() - job->started_ms);
+        audit_export(export_job.detail_rows);
+    } else {
+        printf(RED "\n❌ Background report export failed.\n" RESET);
+    }
+    fflush(stdout);
+}
+
+// Pushed-down exports stream on the background connection so the
+// operator is not held at this screen while a large table is written out
+int start_background_export(FILE* report) {
+    write_behind_flush();
+    memset(&export_job, 0, sizeof(export_job));
+    export_job.report = report;
+    
+    BackgroundJob job = {0};
+    strcpy(job.label, "Report export");
+    job.read_only = 1;
+    job.send_stage = send_export_stage;
+    job.on_finish = finish_export;
+    return start_background_job(&job);
+}
+
+void export_report(void) {
+    display_banner();
+    printf(BOLD YELLOW "📄 EXPORT INVENTORY REPORT\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    int pushdown = reports_pushed_down();
+    if (pushdown && background_job.active) {
+        printf(YELLOW "⚠️  %s is already running in the background.\n" RESET, background_job.label);
+        wait_for_enter();
+        return;
+    }
+    
+    FILE* report = fopen("inventory_report.txt", "w");
+    if (!report) {
+        printf(RED "❌ Error creating report file.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    if (pushdown && start_background_export(report)) {
+        printf(GREEN "⏳ Report export started in the background.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    InventorySummary summary;
+    if (pushdown) {
+        if (!summarize_inventory_in_db(&summary)) {
+            printf(RED "❌ Inventory summary query failed.\n" RESET);
+            fclose(report);
+            wait_for_enter();
+            return;
+        }
+    } else {
+        summarize_inventory_locally(&summary);
+    }
+    
+    write_report_header(report, &summary);
+    long rows = 0;
+    if (pushdown) {
+        rows = storage->scan_equipment(write_report_row, report);
+        if (rows < 0) {
+            fprintf(report, "(detail listing incomplete: database scan failed)\n");
+        }
+    } else {
+        for (int i = 0; i < item_count; i++) {
+            write_report_row(&inventory[i], report);
+        }
+        rows = item_count;
+    }
+    
+    fclose(report);
+    printf(GREEN "✅ Report exported to 'inventory_report.txt'\n" RESET);
+    audit_export(rows < 0 ? 0 : rows);
+    wait_for_enter();
+}
+
+int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile over the retained samples, in milliseconds
+double sample_percentile(const int* sorted, int count, int percentile) {
+    int rank = (count * percentile + 99) / 100;
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1] / 1000.0;
+}
+
+void query_statistics(void) {
+    display_banner();
+    printf(BOLD YELLOW "📈 QUERY STATISTICS\n" RESET);
+    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    
+    if (query_stats_count == 0) {
+        printf(YELLOW "⚠️  No database queries recorded this session.\n" RESET);
+        wait_for_enter();
+        return;
+    }
+    
+    printf(BOLD "%-30s %8s %10s %10s %10s %6s %6s\n" RESET,
+           "Statement", "Calls", "p50 ms", "p99 ms", "Max ms", "Slow", "T/O");
+    printf("────────────────────────────────────────────────────────────────────────────────\n");
+    
+    int sorted[QUERY_SAMPLES];
+    for (int i = 0; i < query_stats_count; i++) {
+        const QueryStats* stats = &query_stats[i];
+        memcpy(sorted, stats->samples, stats->sample_count * sizeof(int));
+        qsort(sorted, stats->sample_count, sizeof(int), compare_ints);
+        
+        printf("%-30.30s %8ld %10.2f %10.2f %10.2f %6ld %6ld\n", stats->name, stats->calls,
+               sample_percentile(sorted, stats->sample_count, 50),
+               sample_percentile(sorted, stats->sample_count, 99),
+               sorted[stats->sample_count - 1] / 1000.0, stats->slow, stats->timeouts);
+    }
+    
+    printf("\n" CYAN "Percentiles cover the last %d calls per statement. " RESET, QUERY_SAMPLES);
+    if (db_config.slow_query_ms > 0) {
+        printf(CYAN "Calls over %d ms are logged to '%s'.\n" RESET,
+               db_config.slow_query_ms, db_config.slow_query_log);
+    } else {
+        printf(CYAN "Slow-query logging is off.\n" RESET);
+    }
+    wait_for_enter();
+}
+
+// ============================================================================
+// EVENT LOOP AND BACKGROUND JOBS
+// ============================================================================
+
+// Buffered operator input; read() on the raw descriptor so poll() on stdin
+// never disagrees with data already sitting in a stdio buffer
+char input_buffer[INPUT_BUFFER_SIZE];
+size_t input_length = 0;
+
+int open_background_connection(void) {
+    if (bg_conn && PQstatus(bg_conn) == CONNECTION_OK) return 1;
+    if (bg_conn) PQfinish(bg_conn);
+    
+    char conninfo[512];
+    build_conninfo(conninfo, sizeof(conninfo));
+    bg_conn = PQconnectdb(conninfo);
+    if (PQstatus(bg_conn) != CONNECTION_OK) {
+        printf(YELLOW "⚠️  Warning: Background connection failed: %s\n" RESET, PQerrorMessage(bg_conn));
+        PQfinish(bg_conn);
+        bg_conn = NULL;
+        return 0;
+    }
+    apply_statement_timeout(bg_conn);
+    return 1;
+}
+
+// Sends one stage of the active job; rows come back one at a time
+int send_background_query(const char* select_sql) {
+    char query[MAX_QUERY_LEN + 64];
+    format_untimed_read(query, sizeof(query), select_sql);
+    if (!PQsendQuery(background_job.conn, query)) return -1;
+    PQsetSingleRowMode(background_job.conn);
+    return 1;
+}
+
+void finish_background_job(int ok) {
+    background_job.active = 0;
+    if (!ok) end_untimed_read(background_job.conn);
+    if (background_job.conn == read_conn) read_conn_busy = 0;
+    if (background_job.on_finish) background_job.on_finish(&background_job, ok);
+}
+
+// Runs one job at a time; returns 0 if another job is active or the
+// first stage could not be sent. Read-only jobs borrow the replica when
+// it is fresh.
+int start_background_job(const BackgroundJob* spec) {
+    if (background_job.active) return 0;
+    
+    PGconn* conn = spec->read_only ? read_connection() : db_conn;
+    if (conn == db_conn) {
+        if (!open_background_connection()) return 0;
+        conn = bg_conn;
+    }
+    
+    background_job = *spec;
+    background_job.conn = conn;
+    if (conn == read_conn) read_conn_busy = 1;
+    background_job.active = 1;
+    background_job.stage = 0;
+    background_job.rows = 0;
+    background_job.started_ms = now_ms();
+    if (background_job.send_stage(&background_job) <= 0) {
+        background_job.active = 0;
+        if (conn == read_conn) read_conn_busy = 0;
+        printf(RED "❌ Background query failed: %s\n" RESET, PQerrorMessage(conn));
+        return 0;
+    }
+    return 1;
+}
+
+// Jobs that patch the store wait for the menu so a screen holding a
+// pointer into inventory[] never sees it move; every job waits while
+// db_conn is mid-query since completion handlers may log to it
+int background_job_runnable(void) {
+    if (!background_job.active || db_conn_busy) return 0;
+    return !background_job.mutates_store || ui_at_menu;
+}
+
+// Consumes whatever the server has sent without blocking, delivering
+// completed rows and advancing stages
+void service_background_job(void) {
+    BackgroundJob* job = &background_job;
+    if (!background_job_runnable()) return;
+    
+    if (!PQconsumeInput(job->conn)) {
+        finish_background_job(0);
+        return;
+    }
+    
+    while (job->active && !PQisBusy(job->conn)) {
+        PGresult* res = PQgetResult(job->conn);
+        if (!res) {
+            int sent = job->failed ? -1 : (job->stage++, job->send_stage(job));
+            if (sent <= 0) finish_background_job(sent == 0);
+            return;
+        }
+        
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_SINGLE_TUPLE) {
+            job->rows++;
+            if (!job->failed) job->on_row(res, 0, job->ctx);
+        } else if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
+            printf(RED "\n❌ Background query failed: %s" RESET, PQresultErrorMessage(res));
+            job->failed = 1;
+        }
+        PQclear(res);
+    }
+}
+
+// Abandons the active job, e.g. at shutdown
+void cancel_background_job(void) {
+    if (!background_job.active) return;
+    
+    char errbuf[256];
+    PGcancel* cancel = PQgetCancel(background_job.conn);
+    if (cancel) {
+        PQcancel(cancel, errbuf, sizeof(errbuf));
+        PQfreeCancel(cancel);
+    }
+    PQclear(await_result(background_job.conn));
+    finish_background_job(0);
+}
+
+// Periodic work that used to run only between menu choices
+void run_event_timers(void) {
+    // With the ring running the writer thread owns the loggers
+    if (!atomic_load_explicit(&event_ring.running, memory_order_relaxed)) {
+        logger_tick(&action_logger);
+        audit_tick(&audit_log);
+    }
+    reap_forked_copy(0);
+    if (db_config.snapshot_minutes > 0 &&
+        time(NULL) - last_snapshot >= (time_t)db_config.snapshot_minutes * 60) {
+        take_snapshot(1);
+    }
+    if (!use_database || !db_conn || db_conn_busy) return;
+    
+    write_behind_tick();
+    if (ui_at_menu) process_change_notifications();
+    
+    if (db_config.resync_interval > 0 && !background_job.active &&
+        time(NULL) - last_resync >= db_config.resync_interval) {
+        start_background_resync(0);
+    }
+}
+
+// Waits up to timeout_ms for operator input while servicing the database
+// sockets and timers. Returns 1 when stdin is readable.
+int pump_events(int timeout_ms) {
+    struct pollfd fds[3];
+    int count = 0;
+    
+    fds[count++] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+    if (db_conn && PQsocket(db_conn) >= 0) {
+        fds[count++] = (struct pollfd){PQsocket(db_conn), POLLIN, 0};
+    }
+    if (background_job_runnable() && PQsocket(background_job.conn) >= 0) {
+        fds[count++] = (struct pollfd){PQsocket(background_job.conn), POLLIN, 0};
+    }
+    
+    int ready = poll(fds, count, timeout_ms);
+    if (ready < 0 && errno != EINTR) ready = 0;
+    
+    // Buffer notifications as they arrive; they are applied by the timers
+    if (ready > 0 && count > 1 && fds[1].fd == PQsocket(db_conn) && fds[1].revents) {
+        PQconsumeInput(db_conn);
+    }
+    service_background_job();
+    run_event_timers();
+    
+    return ready > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+void shutdown_system(void) {
+    display_banner();
+    printf(BOLD YELLOW "🔄 Shutting down system...\n" RESET);
+    cancel_background_job();
+    audit_shutdown();
+    close_storage();
+    reap_forked_copy(1);
+    if (db_config.snapshot_minutes > 0) take_snapshot(0);
+    event_ring_stop();
+    logger_close(&action_logger);
+    audit_close(&audit_log);
+    audit_compressor_stop();
+    printf(GREEN "💾 Data saved successfully.\n" RESET);
+    
+    hash_clear();
+    
+    printf(BOLD GREEN "🛡️  Tactical Supply Management System offline.\n" RESET);
+    printf(BOLD WHITE "✅ All systems secured. Mission complete.\n" RESET);
+    exit(0);
+}
+
+// Reads one line of operator input, running the event loop while waiting.
+// End of input shuts the system down cleanly.
+int read_input_line(char* buffer, size_t buffer_size) {
+    fflush(stdout);
+    
+    while (1) {
+        char* newline = memchr(input_buffer, '\n', input_length);
+        if (newline || input_length == sizeof(input_buffer)) {
+            size_t line_length = newline ? (size_t)(newline - input_buffer) : input_length;
+            size_t consumed = newline ? line_length + 1 : input_length;
+            size_t copy = line_length < buffer_size - 1 ? line_length : buffer_size - 1;
+            memcpy(buffer, input_buffer, copy);
+            buffer[copy] = 0;
+            memmove(input_buffer, input_buffer + consumed, input_length - consumed);
+            input_length -= consumed;
+            return (int)copy;
+        }
+        
+        if (!pump_events(EVENT_TICK_MS)) continue;
+        
+        ssize_t n = read(STDIN_FILENO, input_buffer + input_length,
+                         sizeof(input_buffer) - input_length);
+        if (n > 0) {
+            input_length += n;
+        } else if (n == 0 || errno != EINTR) {
+            if (input_length > 0) {
+                input_buffer[input_length++] = '\n';
+                continue;
+            }
+            printf("\n");
+            shutdown_system();
+        }
+    }
+}
+
+// ============================================================================
+// AUDIT LOG DECODER
+// ============================================================================
+
+// Event selection for the decoder; zero fields match everything
+typedef struct {
+    int type;                   // AuditType, or -1 for any
+    long long item_id;
+    long long since_us;
+    long long until_us;
+} AuditFilter;
+
+static inline int get_varint(const uint8_t** cursor, const uint8_t* end, uint64_t* value) {
+    const uint8_t* p = *cursor;
+    // Most fields (type-local IDs, deltas, lengths) fit in one byte
+    if (p < end && *p < 0x80) {
+        *value = *p;
+        *cursor = p + 1;
+        return 1;
+    }
+    
+    uint64_t result = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *cursor = p;
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Decodes the record at *cursor and advances past it. clock_us carries the
+// running timestamp between calls. Returns 1 for a record, 0 at the end of
+// the data and -1 for a truncated frame. Unknown types are skipped whole
+// thanks to the length prefix.
+int decode_audit_record(const uint8_t** cursor, const uint8_t* end,
+                        long long* clock_us, AuditEvent* event) {
+    const uint8_t* p = *cursor;
+    if (p >= end) return 0;
+    
+    uint8_t type = *p++;
+    uint64_t delta, length;
+    if (!get_varint(&p, end, &delta) || !get_varint(&p, end, &length) ||
+        length > (uint64_t)(end - p)) {
+        return -1;
+    }
+    const uint8_t* payload_end = p + length;
+    *cursor = payload_end;
+    *clock_us += (long long)delta;
+    
+    uint64_t v[4] = {0, 0, 0, 0};
+    int fields = type == AUDIT_REQUEST ? 4 : type == AUDIT_ADD || type == AUDIT_UPDATE_QTY ? 3 :
+                 type == AUDIT_DELETE_REQUEST ? 2 : type == AUDIT_SHUTDOWN ? 0 : 1;
+    for (int i = 0; i < fields; i++) {
+        if (!get_varint(&p, payload_end, &v[i])) break;
+    }
+    
+    event->type = (AuditType)type;
+    event->name = NULL;
+    event->name_length = 0;
+    event->id = (long long)v[0];
+    event->item_id = 0;
+    event->values[0] = event->values[1] = event->values[2] = 0;
+    event->tail = p;
+    event->tail_end = payload_end;
+    
+    switch (type) {
+        case AUDIT_SESSION:
+            *clock_us = (long long)v[0] + (long long)delta;
+            event->id = 0;
+            break;
+        case AUDIT_ADD:
+            event->item_id = event->id;
+            event->values[0] = (long long)v[1];
+            if (v[2] <= (uint64_t)(payload_end - p)) {
+                event->name = (const char*)p;
+                event->name_length = (int)v[2];
+                event->tail = p + v[2];
+            }
+            break;
+        case AUDIT_UPDATE_QTY:
+            event->item_id = event->id;
+            event->values[0] = zigzag_decode(v[1]);
+            event->values[1] = zigzag_decode(v[2]);
+            break;
+        case AUDIT_REQUEST:
+            event->item_id = (long long)v[1];
+            event->values[0] = (long long)v[2];
+            event->values[1] = (long long)v[3];
+            break;
+        case AUDIT_DELETE_ITEM:
+            event->item_id = event->id;
+            break;
+        case AUDIT_DELETE_REQUEST:
+            event->item_id = (long long)v[1];
+            break;
+        default:
+            event->values[0] = event->id;
+            event->id = 0;
+            break;
+    }
+    event->timestamp_us = *clock_us;
+    return 1;
+}
+
+static inline int audit_matches(const AuditFilter* filter, const AuditEvent* event) {
+    if (filter->type >= 0 && (int)event->type != filter->type) return 0;
+    if (filter->item_id && event->item_id != filter->item_id) return 0;
+    if (filter->since_us && event->timestamp_us < filter->since_us) return 0;
+    if (filter->until_us && event->timestamp_us > filter->until_us) return 0;
+    return 1;
+}
+
+const char* audit_type_name(AuditType type) {
+    return type < AUDIT_TYPE_COUNT ? AUDIT_TYPE_NAMES[type] : "UNKNOWN";
+}
+
+void format_audit_time(long long timestamp_us, char* out, size_t size) {
+    time_t seconds = (time_t)(timestamp_us / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    size_t n = strftime(out, size, "%Y-%m-%d %H:%M:%S", &local);
+    snprintf(out + n, size - n, ".%06lld", timestamp_us % 1000000);
+}
+
+void print_json_string(const char* text, int length) {
+    putchar('"');
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') printf("\\%c", c);
+        else if (c < 0x20) printf("\\u%04x", c);
+        else putchar(c);
+    }
+    putchar('"');
+}
+
+void print_audit_event(const AuditEvent* event, int json) {
+    char when[40];
+    format_audit_time(event->timestamp_us, when, sizeof(when));
+    
+    if (json) {
+        printf("{\"ts\":\"%s\",\"ts_us\":%lld,\"type\":\"%s\"",
+               when, event->timestamp_us, audit_type_name(event->type));
+        switch (event->type) {
+            case AUDIT_ADD:
+                printf(",\"item\":%lld,\"quantity\":%lld,\"name\":", event->id, event->values[0]);
+                print_json_string(event->name ? event->name : "", event->name_length);
+                break;
+            case AUDIT_UPDATE_QTY:
+                printf(",\"item\":%lld,\"old\":%lld,\"new\":%lld",
+                       event->id, event->values[0], event->values[1]);
+                break;
+            case AUDIT_REQUEST:
+                printf(",\"request\":%lld,\"item\":%lld,\"quantity\":%lld,\"priority\":%lld",
+                       event->id, event->item_id, event->values[0], event->values[1]);
+                break;
+            case AUDIT_DELETE_ITEM:
+                printf(",\"item\":%lld", event->id);
+                break;
+            case AUDIT_DELETE_REQUEST:
+                printf(",\"request\":%lld,\"item\":%lld", event->id, event->item_id);
+                break;
+            case AUDIT_EXPORT:
+                printf(",\"rows\":%lld", event->values[0]);
+                break;
+            case AUDIT_STARTUP:
+                printf(",\"startup_ms\":%lld", event->values[0]);
+                break;
+            default:
+                break;
+        }
+        printf("}\n");
+        return;
+    }
+    
+    printf("%s  %-10s", when, audit_type_name(event->type));
+    switch (event->type) {
+        case AUDIT_ADD:
+            printf("  item %lld \"%.*s\" quantity %lld", event->id, event->name_length,
+                   event->name ? event->name : "", event->values[0]);
+            break;
+        case AUDIT_UPDATE_QTY:
+            printf("  item %lld quantity %lld -> %lld", event->id, event->values[0], event->values[1]);
+            break;
+        case AUDIT_REQUEST:
+            printf("  REQ-%lld item %lld quantity %lld priority %s", event->id, event->item_id,
+                   event->values[0],
+                   event->values[1] >= PRIORITY_LOW && event->values[1] <= PRIORITY_CRITICAL
+                   ? PRIORITY_NAMES[event->values[1]] : "?");
+            break;
+        case AUDIT_DELETE_ITEM:
+            printf("  item %lld", event->id);
+            break;
+        case AUDIT_DELETE_REQUEST:
+            printf("  REQ-%lld item %lld", event->id, event->item_id);
+            break;
+        case AUDIT_EXPORT:
+            printf("  %lld rows", event->values[0]);
+            break;
+        case AUDIT_STARTUP:
+            printf("  ready in %lld ms", event->values[0]);
+            break;
+        default:
+            break;
+    }
+    printf("\n");
+}
+
+// Accepts epoch seconds, "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" (a 'T'
+// separator also works), in local time
+long long parse_audit_time(const char* text) {
+    char* end;
+    long long epoch = strtoll(text, &end, 10);
+    if (*end == 0) return epoch * 1000000;
+    
+    struct tm when = {0};
+    int matched = sscanf(text, "%d-%d-%d%*[ T]%d:%d:%d", &when.tm_year, &when.tm_mon,
+                         &when.tm_mday, &when.tm_hour, &when.tm_min, &when.tm_sec);
+    if (matched < 3) return -1;
+    when.tm_year -= 1900;
+    when.tm_mon -= 1;
+    when.tm_isdst = -1;
+    return (long long)mktime(&when) * 1000000;
+}
+
+int parse_audit_type(const char* name) {
+    for (int t = 0; t < AUDIT_TYPE_COUNT; t++) {
+        if (strcasecmp(name, AUDIT_TYPE_NAMES[t]) == 0) return t;
+    }
+    return -1;
+}
+
+typedef void (*AuditEmit)(const AuditEvent* event, int json);
+
+typedef struct {
+    int segments;
+    int segments_read;
+    long blocks;
+    long blocks_read;
+    long long bytes_read;
+    long records;
+    long matched;
+} AuditQueryStats;
+
+// Decodes every record in [start, end) and emits the matching ones.
+// Returns the final decode_audit_record() status.
+int scan_audit_range(const uint8_t* start, const uint8_t* end, const AuditFilter* filter,
+                     AuditEmit emit, int json, AuditQueryStats* stats) {
+    const uint8_t* cursor = start;
+    long long clock_us = 0;
+    AuditEvent event;
+    int status;
+    while ((status = decode_audit_record(&cursor, end, &clock_us, &event)) > 0) {
+        stats->records++;
+        if (event.type == AUDIT_SESSION && filter->type != AUDIT_SESSION) continue;
+        if (audit_matches(filter, &event)) {
+            stats->matched++;
+            if (emit) emit(&event, json);
+        }
+    }
+    return status;
+}
+
+// Number of blocks that start before at_us (or at it, when inclusive)
+long audit_blocks_before(const AuditTimeEntry* times, long blocks, long long at_us, int inclusive) {
+    long low = 0, high = blocks;
+    while (low < high) {
+        long mid = low + (high - low) / 2;
+        if (times[mid].first_us < at_us || (inclusive && times[mid].first_us == at_us)) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// One segment mapped for reading, raw or compressed
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    const AuditTimeEntry* times;
+    size_t time_size;
+    long blocks;
+    const AuditCompressedEntry* packed;     // Block index; NULL for a raw segment
+    size_t packed_size;
+    uint8_t* buffer;                        // Inflated block
+    size_t buffer_size;
+} AuditSegmentView;
+
+// Decodes block b. In a raw segment the last block runs to the end of the
+// data, which also covers records whose index entry never reached the disk.
+int scan_audit_block(AuditSegmentView* view, long b, const AuditFilter* filter,
+                     AuditEmit emit, int json, AuditQueryStats* stats) {
+    if (view->packed) {
+        const AuditCompressedEntry* entry = &view->packed[b];
+        if ((size_t)entry->offset + entry->length > view->size) return -1;
+        if (entry->raw_length > view->buffer_size) {
+            uint8_t* grown = realloc(view->buffer, entry->raw_length);
+            if (!grown) return -1;
+            view->buffer = grown;
+            view->buffer_size = entry->raw_length;
+        }
+        uLongf length = entry->raw_length;
+        if (uncompress(view->buffer, &length, view->data + entry->offset, entry->length) != Z_OK) {
+            return -1;
+        }
+        stats->blocks_read++;
+        stats->bytes_read += entry->length;
+        return scan_audit_range(view->buffer, view->buffer + length, filter, emit, json, stats);
+    }
+    
+    size_t start = (size_t)view->times[b].offset;
+    size_t end = b + 1 < view->blocks ? (size_t)view->times[b + 1].offset : view->size;
+    if (start < AUDIT_MAGIC_LEN) start = AUDIT_MAGIC_LEN;
+    if (end > view->size) end = view->size;
+    if (start >= end) return 0;
+    stats->blocks_read++;
+    stats->bytes_read += end - start;
+    return scan_audit_range(view->data + start, view->data + end, filter, emit, json, stats);
+}
+
+void close_audit_segment(AuditSegmentView* view) {
+    if (view->data) munmap((void*)view->data, view->size);
+    if (view->times) munmap((void*)view->times, view->time_size);
+    if (view->packed) munmap((void*)view->packed, view->packed_size);
+    free(view->buffer);
+    memset(view, 0, sizeof(*view));
+}
+
+// Maps segment `sequence`, preferring the raw file while both exist. A
+// compressed segment needs its time and block indexes to be read at all.
+int open_audit_segment(const char* dir, int sequence, int use_index, AuditSegmentView* view) {
+    char path[192];
+    memset(view, 0, sizeof(*view));
+    audit_segment_path(path, sizeof(path), dir, sequence, "audit");
+    view->data = map_audit_file(path, &view->size);
+    if (!view->data) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "zaudit");
+        view->data = map_file(path, &view->size);
+        audit_segment_path(path, sizeof(path), dir, sequence, "zidx");
+        view->packed = (const AuditCompressedEntry*)map_file(path, &view->packed_size);
+        if (!view->data || !view->packed || view->size < AUDIT_MAGIC_LEN ||
+            memcmp(view->data, AUDIT_COMPRESSED_MAGIC, AUDIT_MAGIC_LEN) != 0) {
+            close_audit_segment(view);
+            return 0;
+        }
+        use_index = 1;
+    }
+    if (use_index) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "tidx");
+        view->times = (const AuditTimeEntry*)map_file(path, &view->time_size);
+    }
+    view->blocks = view->time_size / sizeof(AuditTimeEntry);
+    if (view->packed) {
+        long packed_blocks = view->packed_size / sizeof(AuditCompressedEntry);
+        if (packed_blocks < view->blocks) view->blocks = packed_blocks;
+    }
+    return 1;
+}
+
+// Reads the blocks of one segment that can hold matching events: a binary
+// search of the time index bounds the range, and the item index narrows it
+// to blocks that mention filter->item_id
+int query_audit_segment(const char* dir, int sequence, long indexed_blocks, const AuditFilter* filter,
+                        int use_index, AuditEmit emit, int json, AuditQueryStats* stats) {
+    AuditSegmentView view;
+    if (!open_audit_segment(dir, sequence, use_index, &view)) return 0;
+    stats->segments_read++;
+    
+    int status = 0;
+    if (!view.packed && view.blocks == 0) {
+        // Raw segment read whole
+        madvise((void*)view.data, view.size, MADV_SEQUENTIAL);
+        status = scan_audit_range(view.data + AUDIT_MAGIC_LEN, view.data + view.size,
+                                  filter, emit, json, stats);
+        stats->blocks_read += indexed_blocks ? indexed_blocks : 1;
+        stats->bytes_read += view.size;
+        close_audit_segment(&view);
+        return status;
+    }
+    
+    long blocks = view.blocks;
+    long first = 0, last = blocks - 1;
+    if (use_index) {
+        if (filter->since_us) first = audit_blocks_before(view.times, blocks, filter->since_us, 0) - 1;
+        if (filter->until_us) last = audit_blocks_before(view.times, blocks, filter->until_us, 1) - 1;
+        if (first < 0) first = 0;
+    }
+    
+    char path[192];
+    size_t item_size = 0;
+    const AuditItemEntry* items = NULL;
+    int sorted = 0;
+    if (use_index && filter->item_id) {
+        audit_segment_path(path, sizeof(path), dir, sequence, "sidx");
+        items = (const AuditItemEntry*)map_file(path, &item_size);
+        sorted = items != NULL;
+        if (!items) {
+            audit_segment_path(path, sizeof(path), dir, sequence, "iidx");
+            items = (const AuditItemEntry*)map_file(path, &item_size);
+        }
+    }
+    
+    if (sorted) {
+        // Sealed segment: the item's entries are contiguous and in block order
+        long count = item_size / sizeof(AuditItemEntry);
+        AuditItemEntry key = {(uint32_t)filter->item_id, (uint32_t)first};
+        long low = 0, high = count;
+        while (low < high) {
+            long mid = low + (high - low) / 2;
+            if (compare_audit_items(&items[mid], &key) < 0) low = mid + 1;
+            else high = mid;
+        }
+        for (long i = low; i < count && items[i].item_id == key.item_id &&
+             (long)items[i].block <= last && status >= 0; i++) {
+            if ((long)items[i].block < blocks) {
+                status = scan_audit_block(&view, items[i].block, filter, emit, json, stats);
+            }
+        }
+        munmap((void*)items, item_size);
+    } else if (items) {
+        // Entries are in block order, so the range starts at a binary search
+        long count = item_size / sizeof(AuditItemEntry);
+        long low = 0, high = count;
+        while (low < high) {
+            long mid = low + (high - low) / 2;
+            if ((long)items[mid].block < first) low = mid + 1;
+            else high = mid;
+        }
+        for (long i = low; i < count && (long)items[i].block <= last && status >= 0; i++) {
+            if (items[i].item_id == (uint32_t)filter->item_id && (long)items[i].block < blocks) {
+                status = scan_audit_block(&view, items[i].block, filter, emit, json, stats);
+            }
+        }
+        munmap((void*)items, item_size);
+    } else {
+        for (long b = first; b <= last && status >= 0; b++) {
+            status = scan_audit_block(&view, b, filter, emit, json, stats);
+        }
+    }
+    
+    close_audit_segment(&view);
+    return status;
+}
+
+// Runs filter over every segment in dir. With use_index, segments outside
+// the time range are skipped on their first timestamps alone and the rest
+// are read block by block; otherwise every record is decoded. Returns -1
+// when dir cannot be read and a negative status on a truncated record.
+int query_audit_dir(const char* dir, const AuditFilter* filter, int use_index,
+                    AuditEmit emit, int json, AuditQueryStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    int* sequences;
+    int count = list_audit_segments(dir, &sequences);
+    if (count < 0) return -1;
+    stats->segments = count;
+    
+    int status = 0;
+    long long next_first = count ? audit_segment_first_us(dir, sequences[0]) : LLONG_MAX;
+    for (int i = 0; i < count; i++) {
+        long long first_us = next_first;
+        next_first = i + 1 < count ? audit_segment_first_us(dir, sequences[i + 1]) : LLONG_MAX;
+        
+        char path[192];
+        audit_segment_path(path, sizeof(path), dir, sequences[i], "tidx");
+        long blocks = file_size(path) / sizeof(AuditTimeEntry);
+        stats->blocks += blocks;
+        
+        if (status < 0) continue;
+        if (use_index && ((filter->until_us && first_us != LLONG_MAX && first_us > filter->until_us) ||
+                          (filter->since_us && next_first < filter->since_us))) {
+            continue;
+        }
+        status = query_audit_segment(dir, sequences[i], blocks, filter, use_index, emit, json, stats);
+    }
+    free(sequences);
+    return status;
+}
+
+// --audit [DIR|FILE] [--json] [--scan] [--type NAME] [--item ID] [--since TIME] [--until TIME]
+// A directory is queried through its indexes unless --scan is given; a
+// single segment file is always decoded whole.
+int run_audit_decoder(int argc, char** argv) {
+    const char* path = AUDIT_DIR;
+    AuditFilter filter = {-1, 0, 0, 0};
+    int json = 0, use_index = 1;
+    
+    for (int i = 0; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (strcmp(argv[i], "--scan") == 0) {
+            use_index = 0;
+        } else if (strcmp(argv[i], "--type") == 0 && value) {
+            filter.type = parse_audit_type(value);
+            if (filter.type < 0) {
+                fprintf(stderr, "Unknown event type '%s'\n", value);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--item") == 0 && value) {
+            filter.item_id = atoll(value);
+            i++;
+        } else if ((strcmp(argv[i], "--since") == 0 || strcmp(argv[i], "--until") == 0) && value) {
+            long long at = parse_audit_time(value);
+            if (at < 0) {
+                fprintf(stderr, "Cannot parse time '%s'\n", value);
+                return 1;
+            }
+            if (argv[i][2] == 's') filter.since_us = at;
+            else filter.until_us = at + 999999;
+            i++;
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: --audit [DIR|FILE] [--json] [--scan] [--type NAME] [--item ID] "
+                            "[--since TIME] [--until TIME]\n");
+            return 1;
+        }
+    }
+    
+    AuditQueryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    long long started = now_us();
+    int status;
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        status = query_audit_dir(path, &filter, use_index, print_audit_event, json, &stats);
+    } else {
+        size_t size;
+        const uint8_t* data = map_audit_file(path, &size);
+        if (!data) {
+            fprintf(stderr, "Cannot read audit log '%s'\n", path);
+            return 1;
+        }
+        madvise((void*)data, size, MADV_SEQUENTIAL);
+        status = scan_audit_range(data + AUDIT_MAGIC_LEN, data + size, &filter,
+                                  print_audit_event, json, &stats);
+        stats.segments = stats.segments_read = 1;
+        stats.bytes_read = size;
+        munmap((void*)data, size);
+    }
+    double elapsed_ms = (now_us() - started) / 1000.0;
+    
+    if (status == -1 && stats.segments == 0 && stats.records == 0) {
+        fprintf(stderr, "Cannot read audit log '%s'\n", path);
+        return 1;
+    }
+    if (status < 0) {
+        fprintf(stderr, "Truncated record in '%s'\n", path);
+    }
+    if (stats.blocks) {
+        fprintf(stderr, "%ld of %ld records matched; read %ld of %ld blocks in %d of %d segments "
+                        "(%.1f KB) in %.2f ms\n", stats.matched, stats.records, stats.blocks_read,
+                stats.blocks, stats.segments_read, stats.segments, stats.bytes_read / 1024.0, elapsed_ms);
+    } else {
+        fprintf(stderr, "%ld of %ld records matched in %.2f ms\n", stats.matched, stats.records, elapsed_ms);
+    }
+    return status < 0 ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Event replay
+// ----------------------------------------------------------------------------
+
+// Replay writes straight into inventory[] and requests[]. IDs resolve
+// through an open-addressed table rather than find_by_id()'s linear scan,
+// and the name hash is rebuilt once after the last event.
+#define REPLAY_MIN_SLOTS 64
+#define REPLAY_MAX_SLOTS (1u << 30)
+
+typedef struct {
+    int id;                     // 0 = empty
+    int index;                  // -1 = deleted
+} ReplaySlot;
+
+// Every ID the log mentions keeps its slot, deleted or not, so the table
+// grows with the history rather than with MAX_ITEMS / MAX_REQUESTS
+typedef struct {
+    ReplaySlot* slots;
+    unsigned int mask;          // Capacity - 1; capacity is a power of two
+    unsigned int used;          // Slots holding an ID, deleted ones included
+} ReplayTable;
+
+typedef struct {
+    ReplayTable items;
+    ReplayTable requests;
+    long applied;
+    long orphaned;              // Updates to items added before the log began
+    long dropped;               // Rows past MAX_ITEMS / MAX_REQUESTS, or with no slot
+} ReplayState;
+
+static ReplayState replay_state;
+
+// Returns id's entry, or the empty slot it would take. NULL only when no
+// slot is empty, which replay_claim() never lets happen.
+static inline ReplaySlot* replay_slot(const ReplayTable* table, int id) {
+    if (!table->slots) return NULL;
+    unsigned int i = (unsigned int)id * 2654435761u;
+    for (unsigned int probes = 0; probes <= table->mask; probes++, i++) {
+        ReplaySlot* slot = &table->slots[i & table->mask];
+        if (slot->id == id || slot->id == 0) return slot;
+    }
+    return NULL;
+}
+
+// Reallocates the table at most half full with room for `expected` IDs,
+// keeping only live entries. Returns 0, with the table unchanged, if the
+// slots cannot be allocated.
+static int replay_resize(ReplayTable* table, unsigned int expected) {
+    unsigned int capacity = REPLAY_MIN_SLOTS;
+    while (capacity / 2 < expected) {
+        if (capacity == REPLAY_MAX_SLOTS) return 0;
+        capacity *= 2;
+    }
+    ReplaySlot* slots = calloc(capacity, sizeof(ReplaySlot));
+    if (!slots) return 0;
+    
+    ReplayTable resized = {slots, capacity - 1, 0};
+    for (unsigned int i = 0; table->slots && i <= table->mask; i++) {
+        const ReplaySlot* old = &table->slots[i];
+        if (old->id == 0 || old->index < 0) continue;
+        *replay_slot(&resized, old->id) = *old;
+        resized.used++;
+    }
+    free(table->slots);
+    *table = resized;
+    return 1;
+}
+
+// Returns id's entry, giving it a slot first if it has none. A table
+// that reaches half full is resized to leave live entries a quarter of
+// it, so a history of short-lived IDs rehashes instead of growing.
+static ReplaySlot* replay_claim(ReplayTable* table, int id) {
+    ReplaySlot* slot = replay_slot(table, id);
+    if (slot && slot->id == id) return slot;
+    
+    if (table->used + 1 > (table->mask + 1) / 2) {
+        unsigned int live = 0;
+        for (unsigned int i = 0; table->slots && i <= table->mask; i++) {
+            if (table->slots[i].id && table->slots[i].index >= 0) live++;
+        }
+        if (!replay_resize(table, (live + 1) * 2)) return NULL;
+        slot = replay_slot(table, id);
+    }
+    slot->id = id;
+    slot->index = -1;
+    table->used++;
+    return slot;
+}
+
+static void replay_reset_table(ReplayTable* table, unsigned int expected) {
+    free(table->slots);
+    *table = (ReplayTable){0};
+    replay_resize(table, expected);
+}
+
+// Copies a length-prefixed string into out, truncating to fit
+static void get_audit_string(const uint8_t** cursor, const uint8_t* end, char* out, size_t size) {
+    uint64_t length;
+    out[0] = '\0';
+    if (!get_varint(cursor, end, &length) || length > (uint64_t)(end - *cursor)) return;
+    size_t copy = length < size ? (size_t)length : size - 1;
+    memcpy(out, *cursor, copy);
+    out[copy] = '\0';
+    *cursor += length;
+}
+
+static void replay_item(ReplayState* state, const AuditEvent* event) {
+    ReplaySlot* slot = replay_slot(&state->items, (int)event->id);
+    Equipment* item;
+    if (event->type == AUDIT_UPDATE_QTY) {
+        if (!slot || !slot->id || slot->index < 0) {
+            state->orphaned++;
+            return;
+        }
+        item = &inventory[slot->index];
+        item->quantity = (int)event->values[1];
+    } else {
+        if (!slot || !slot->id || slot->index < 0) {
+            if (item_count >= MAX_ITEMS || !(slot = replay_claim(&state->items, (int)event->id))) {
+                state->dropped++;
+                return;
+            }
+            slot->index = item_count++;
+        }
+        item = &inventory[slot->index];
+        memset(item, 0, sizeof(*item));
+        item->id = (int)event->id;
+        item->quantity = (int)event->values[0];
+        int length = event->name_length < MAX_NAME_LEN ? event->name_length : MAX_NAME_LEN - 1;
+        if (event->name) memcpy(item->name, event->name, length);
+        
+        const uint8_t* p = event->tail;
+        uint64_t value;
+        if (get_varint(&p, event->tail_end, &value)) item->min_threshold = (int)value;
+        if (get_varint(&p, event->tail_end, &value)) item->classification = (int)value;
+        get_audit_string(&p, event->tail_end, item->description, MAX_DESC_LEN);
+        get_audit_string(&p, event->tail_end, item->unit, MAX_UNIT_LEN);
+        get_audit_string(&p, event->tail_end, item->location, MAX_LOCATION_LEN);
+        if (item->id >= next_item_id) next_item_id = item->id + 1;
+    }
+    item->last_updated = (time_t)(event->timestamp_us / 1000000);
+    sprintf(item->checksum, "%04d", calculate_checksum(item));
+    state->applied++;
+}
+
+static void replay_request(ReplayState* state, const AuditEvent* event) {
+    ReplaySlot* slot = replay_slot(&state->requests, (int)event->id);
+    if (!slot || !slot->id || slot->index < 0) {
+        if (request_count >= MAX_REQUESTS || !(slot = replay_claim(&state->requests, (int)event->id))) {
+            state->dropped++;
+            return;
+        }
+        slot->index = request_count++;
+    }
+    
+    SupplyRequest* req = &requests[slot->index];
+    memset(req, 0, sizeof(*req));
+    req->req_id = (int)event->id;
+    req->equipment_id = (int)event->item_id;
+    req->requested_qty = (int)event->values[0];
+    req->priority = (int)event->values[1];
+    req->request_time = (time_t)(event->timestamp_us / 1000000);
+    req->status = REQ_PENDING;
+    
+    const uint8_t* p = event->tail;
+    uint64_t value;
+    if (get_varint(&p, event->tail_end, &value)) req->status = (RequestStatus)value;
+    get_audit_string(&p, event->tail_end, req->requesting_unit, MAX_UNIT_LEN);
+    if (get_varint(&p, event->tail_end, &value)) req->request_time = (time_t)value;
+    if (req->req_id >= next_request_id) next_request_id = req->req_id + 1;
+    state->applied++;
+}
+
+// Deletes shift the rows after the removed one down, as remove_equipment()
+// and remove_request() do, so their slots move with them. The slot stays
+// marked deleted to keep the probe chains through it intact until the
+// table is next resized.
+static void replay_delete_item(ReplayState* state, int id) {
+    ReplaySlot* slot = replay_slot(&state->items, id);
+    if (!slot || !slot->id || slot->index < 0) {
+        state->orphaned++;
+        return;
+    }
+    int index = slot->index;
+    memmove(&inventory[index], &inventory[index + 1], (item_count - index - 1) * sizeof(Equipment));
+    item_count--;
+    slot->index = -1;
+    for (int i = index; i < item_count; i++) {
+        ReplaySlot* moved = replay_slot(&state->items, inventory[i].id);
+        if (moved && moved->id) moved->index = i;
+    }
+    state->applied++;
+}
+
+static void replay_delete_request(ReplayState* state, int req_id) {
+    ReplaySlot* slot = replay_slot(&state->requests, req_id);
+    if (!slot || !slot->id || slot->index < 0) {
+        state->orphaned++;
+        return;
+    }
+    int index = slot->index;
+    memmove(&requests[index], &requests[index + 1], (request_count - index - 1) * sizeof(SupplyRequest));
+    request_count--;
+    slot->index = -1;
+    for (int i = index; i < request_count; i++) {
+        ReplaySlot* moved = replay_slot(&state->requests, requests[i].req_id);
+        if (moved && moved->id) moved->index = i;
+    }
+    state->applied++;
+}
+
+void replay_audit_event(const AuditEvent* event, int json) {
+    (void)json;
+    if (event->id <= 0 || event->id > INT_MAX) return;
+    switch (event->type) {
+        case AUDIT_ADD:
+        case AUDIT_UPDATE_QTY:
+            replay_item(&replay_state, event);
+            break;
+        case AUDIT_REQUEST:
+            replay_request(&replay_state, event);
+            break;
+        case AUDIT_DELETE_ITEM:
+            replay_delete_item(&replay_state, (int)event->id);
+            break;
+        case AUDIT_DELETE_REQUEST:
+            replay_delete_request(&replay_state, (int)event->id);
+            break;
+        default:
+            break;
+    }
+}
+
+// Applies the events in (since_us, until_us] on top of the current
+// inventory[] and requests[] (0 = unbounded). Blocks outside the range are
+// never read. Returns the query_audit_dir() status.
+int replay_audit_events(const char* dir, long long since_us, long long until_us,
+                        AuditQueryStats* stats) {
+    replay_reset_table(&replay_state.items, MAX_ITEMS);
+    replay_reset_table(&replay_state.requests, MAX_REQUESTS);
+    replay_state.applied = replay_state.orphaned = replay_state.dropped = 0;
+    for (int i = 0; i < item_count; i++) {
+        ReplaySlot* slot = replay_claim(&replay_state.items, inventory[i].id);
+        if (slot) slot->index = i;
+    }
+    for (int i = 0; i < request_count; i++) {
+        ReplaySlot* slot = replay_claim(&replay_state.requests, requests[i].req_id);
+        if (slot) slot->index = i;
+    }
+    
+    AuditFilter filter = {-1, 0, since_us, until_us};
+    int status = query_audit_dir(dir, &filter, 1, replay_audit_event, 0, stats);
+    hash_rebuild();
+    return status;
+}
+
+// Replaces inventory[] and requests[] with the state the audit log in dir
+// describes as of until_us (0 = the end of the log)
+int replay_audit_log(const char* dir, long long until_us, AuditQueryStats* stats) {
+    item_count = 0;
+    request_count = 0;
+    next_item_id = 1;
+    next_request_id = 1;
+    return replay_audit_events(dir, 0, until_us, stats);
+}
+
+// --replay [DIR] [--to TIME] [--list]
+// Rebuilds the inventory from the audit log alone and prints what it held
+int run_replay(int argc, char** argv) {
+    const char* dir = AUDIT_DIR;
+    long long until_us = 0;
+    int list = 0;
+    
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            until_us = parse_audit_time(argv[++i]);
+            if (until_us < 0) {
+                fprintf(stderr, "Cannot parse time '%s'\n", argv[i]);
+                return 1;
+            }
+            until_us += 999999;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = 1;
+        } else if (argv[i][0] != '-') {
+            dir = argv[i];
+        } else {
+            fprintf(stderr, "Usage: --replay [DIR] [--to TIME] [--list]\n");
+            return 1;
+        }
+    }
+    
+    AuditQueryStats stats;
+    long long started = now_us();
+    int status = replay_audit_log(dir, until_us, &stats);
+    long long elapsed_us = now_us() - started;
+    
+    if (status == -1 && stats.segments == 0) {
+        fprintf(stderr, "Cannot read audit log '%s'\n", dir);
+        return 1;
+    }
+    if (status < 0) {
+        fprintf(stderr, "Truncated record in '%s'; state is as of the last whole record\n", dir);
+    }
+    
+    if (list) {
+        for (int i = 0; i < item_count; i++) {
+            const Equipment* item = &inventory[i];
+            printf("item %d  \"%s\"  quantity %d %s  min %d  %s  %s\n", item->id, item->name,
+                   item->quantity, item->unit, item->min_threshold, item->location,
+                   CLASS_NAMES[item->classification & 3]);
+        }
+        for (int i = 0; i < request_count; i++) {
+            const SupplyRequest* req = &requests[i];
+            printf("REQ-%d  item %d  quantity %d  %s  %s  %s\n", req->req_id, req->equipment_id,
+                   req->requested_qty, req->requesting_unit,
+                   PRIORITY_NAMES[req->priority >= PRIORITY_LOW && req->priority <= PRIORITY_CRITICAL
+                                  ? req->priority : 0],
+                   STATUS_NAMES[req->status & 3]);
+        }
+    }
+    
+    char when[40] = "end of log";
+    if (until_us) format_audit_time(until_us, when, sizeof(when));
+    printf("%d equipment items and %d requests as of %s\n", item_count, request_count, when);
+    fprintf(stderr, "%ld events applied (%ld orphaned updates, %ld dropped) from %ld records in "
+                    "%ld blocks; %.2f ms, %.2f M events/s\n",
+            replay_state.applied, replay_state.orphaned, replay_state.dropped, stats.records,
+            stats.blocks_read, elapsed_us / 1000.0,
+            elapsed_us ? (double)stats.records / elapsed_us : 0.0);
+    return status < 0 ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Deduplicated backup store
+// ----------------------------------------------------------------------------
+
+// A backup is a manifest (backup-YYYYMMDD-HHMMSS.manifest) listing, for each
+// data file, the chunks that make it up. Chunks are cut where the content
+// says so rather than at fixed offsets, so a change to one record moves
+// only the boundaries around it, and each chunk is stored once under
+// chunks/xx/<sha256>.chunk however many backups use it.
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t* state, const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      SHA256_K[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+// SHA-256 of data as 64 lowercase hex digits
+void sha256_hex(const uint8_t* data, size_t length, char* hex) {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    size_t whole = length & ~(size_t)63;
+    for (size_t i = 0; i < whole; i += 64) sha256_block(state, data + i);
+    
+    uint8_t tail[128] = {0};
+    size_t rest = length - whole;
+    memcpy(tail, data + whole, rest);
+    tail[rest] = 0x80;
+    size_t tail_size = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++) tail[tail_size - 1 - i] = (uint8_t)(bits >> (i * 8));
+    sha256_block(state, tail);
+    if (tail_size == 128) sha256_block(state, tail + 64);
+    
+    for (int i = 0; i < 8; i++) sprintf(hex + i * 8, "%08x", state[i]);
+}
+
+// Gear hash for content-defined chunking: each byte shifts the hash left
+// and adds a random value, so its top bits depend on the last 64 bytes only
+static uint64_t chunk_gear[256];
+
+static void chunk_gear_init(void) {
+    if (chunk_gear[0]) return;
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        chunk_gear[i] = z ^ (z >> 31);
+    }
+}
+
+// Streams data files into the chunk store and the manifest. Static so the
+// forked backup child needs no allocation.
+typedef struct {
+    int manifest_fd;
+    char chunk_dir[192];
+    uint8_t buffer[CHUNK_MAX_BYTES];
+    size_t length;
+    uint64_t hash;
+    BackupStats stats;
+    int ok;
+} Chunker;
+
+static Chunker backup_chunker;
+BackupStats last_backup_stats;
+
+static void write_manifest_line(Chunker* chunker, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (write(chunker->manifest_fd, line, length) != length) chunker->ok = 0;
+}
+
+void chunk_path(char* out, size_t size, const char* chunk_dir, const char* hex) {
+    snprintf(out, size, "%s/%.2s/%s.chunk", chunk_dir, hex, hex);
+}
+
+// Stores the buffered chunk unless an identical one is already there
+static void chunker_emit(Chunker* chunker) {
+    char hex[65], path[288];
+    sha256_hex(chunker->buffer, chunker->length, hex);
+    chunk_path(path, sizeof(path), chunker->chunk_dir, hex);
+    
+    if (access(path, F_OK) != 0) {
+        char subdir[200];
+        snprintf(subdir, sizeof(subdir), "%s/%.2s", chunker->chunk_dir, hex);
+        mkdir(subdir, 0755);
+        if (write_file_atomic(path, chunker->buffer, chunker->length)) {
+            chunker->stats.new_chunks++;
+            chunker->stats.new_bytes += chunker->length;
+        } else {
+            chunker->ok = 0;
+        }
+    }
+    write_manifest_line(chunker, "%s %zu\n", hex, chunker->length);
+    chunker->stats.chunks++;
+    chunker->stats.total_bytes += chunker->length;
+    chunker->length = 0;
+    chunker->hash = 0;
+}
+
+static void chunker_feed(Chunker* chunker, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        chunker->buffer[chunker->length++] = bytes[i];
+        chunker->hash = (chunker->hash << 1) + chunk_gear[bytes[i]];
+        if ((chunker->length >= CHUNK_MIN_BYTES && (chunker->hash >> (64 - CHUNK_AVG_BITS)) == 0) ||
+            chunker->length == CHUNK_MAX_BYTES) {
+            chunker_emit(chunker);
+        }
+    }
+}
+
+// One data file in the file engine's layout: count, next ID, records.
+// Chunking restarts at each file so boundaries never straddle two.
+static void chunk_data_file(Chunker* chunker, const char* name, int count, int next_id,
+                            const void* records, size_t record_size) {
+    int header[2] = {count, next_id};
+    write_manifest_line(chunker, "file %s %zu\n", name, sizeof(header) + count * record_size);
+    chunker_feed(chunker, header, sizeof(header));
+    chunker_feed(chunker, records, count * record_size);
+    if (chunker->length) chunker_emit(chunker);
+}
+
+// Backs up inventory[] and requests[] as the manifest at path, with the
+// chunk store in the same directory. Writes nothing but files, so the
+// forked backup child can run it.
+int write_backup_manifest(const char* path, long long taken_us) {
+    Chunker* chunker = &backup_chunker;
+    chunk_gear_init();
+    memset(&chunker->stats, 0, sizeof(chunker->stats));
+    chunker->length = 0;
+    chunker->hash = 0;
+    chunker->ok = 1;
+    
+    const char* slash = strrchr(path, '/');
+    snprintf(chunker->chunk_dir, sizeof(chunker->chunk_dir), "%.*s/chunks",
+             slash ? (int)(slash - path) : 1, slash ? path : ".");
+    if (mkdir(chunker->chunk_dir, 0755) != 0 && errno != EEXIST) return 0;
+    
+    char temp[256];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    chunker->manifest_fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (chunker->manifest_fd < 0) return 0;
+    
+    write_manifest_line(chunker, "%s %lld\n", BACKUP_MANIFEST_MAGIC, taken_us);
+    chunk_data_file(chunker, DATA_FILE, item_count, next_item_id, inventory, sizeof(Equipment));
+    chunk_data_file(chunker, REQUEST_FILE, request_count, next_request_id, requests,
+                    sizeof(SupplyRequest));
+    write_manifest_line(chunker, "stats %ld %ld %lld %lld\nend\n", chunker->stats.chunks,
+                        chunker->stats.new_chunks, chunker->stats.new_bytes, chunker->stats.total_bytes);
+    
+    if (fsync(chunker->manifest_fd) != 0) chunker->ok = 0;
+    if (close(chunker->manifest_fd) != 0) chunker->ok = 0;
+    if (chunker->ok) chunker->ok = rename(temp, path) == 0;
+    if (!chunker->ok) unlink(temp);
+    last_backup_stats = chunker->stats;
+    return chunker->ok;
+}
+
+// Parsed manifest: chunks in file order with their output offsets
+typedef struct {
+    char hex[65];
+    uint32_t length;
+    int file;
+    long long offset;
+} ManifestChunk;
+
+typedef struct {
+    char name[64];
+    long long size;
+} ManifestFile;
+
+typedef struct {
+    long long taken_us;
+    ManifestFile files[2];
+    int file_count;
+    ManifestChunk* chunks;
+    int chunk_count;
+} Manifest;
+
+// Returns 0 unless the manifest is complete and its chunk lengths add up
+int read_manifest(const char* path, Manifest* manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    
+    char line[256], magic[16];
+    int ok = fgets(line, sizeof(line), file) &&
+             sscanf(line, "%15s %lld", magic, &manifest->taken_us) == 2 &&
+             strcmp(magic, BACKUP_MANIFEST_MAGIC) == 0;
+    int capacity = 0, complete = 0;
+    long long offset = 0;
+    while (ok && !complete && fgets(line, sizeof(line), file)) {
+        char name[64];
+        long long size;
+        ManifestChunk chunk;
+        if (sscanf(line, "file %63s %lld", name, &size) == 2) {
+            if (manifest->file_count == 2) {
+                ok = 0;
+                break;
+            }
+            ManifestFile* entry = &manifest->files[manifest->file_count++];
+            snprintf(entry->name, sizeof(entry->name), "%s", name);
+            entry->size = size;
+            offset = 0;
+        } else if (sscanf(line, "%64[0-9a-f] %u", chunk.hex, &chunk.length) == 2 &&
+                   strlen(chunk.hex) == 64 && manifest->file_count > 0) {
+            if (manifest->chunk_count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                ManifestChunk* grown = realloc(manifest->chunks, capacity * sizeof(ManifestChunk));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                manifest->chunks = grown;
+            }
+            chunk.file = manifest->file_count - 1;
+            chunk.offset = offset;
+            offset += chunk.length;
+            manifest->chunks[manifest->chunk_count++] = chunk;
+        } else if (strcmp(line, "end\n") == 0) {
+            complete = 1;
+        }
+    }
+    fclose(file);
+    
+    // Every file's chunks must cover exactly its recorded size
+    for (int f = 0; ok && f < manifest->file_count; f++) {
+        long long covered = 0;
+        for (int i = 0; i < manifest->chunk_count; i++) {
+            if (manifest->chunks[i].file == f) covered += manifest->chunks[i].length;
+        }
+        ok = covered == manifest->files[f].size;
+    }
+    if (!ok || !complete) {
+        free(manifest->chunks);
+        manifest->chunks = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    const Manifest* manifest;
+    const char* chunk_dir;
+    int fds[2];
+    _Atomic int next;           // Next chunk to claim
+    _Atomic int failed;
+    _Atomic long long bytes;
+} ChunkRestore;
+
+// Restore worker: claims chunks one at a time, checks each against its
+// hash and writes it at its offset. pwrite() lets workers fill the same
+// file in any order.
+void* chunk_restore_main(void* arg) {
+    ChunkRestore* job = arg;
+    const Manifest* manifest = job->manifest;
+    uint8_t* buffer = malloc(CHUNK_MAX_BYTES);
+    if (!buffer) {
+        atomic_store(&job->failed, 1);
+        return NULL;
+    }
+    
+    int i;
+    while (!atomic_load(&job->failed) && (i = atomic_fetch_add(&job->next, 1)) < manifest->chunk_count) {
+        const ManifestChunk* chunk = &manifest->chunks[i];
+        char path[288], hex[65];
+        chunk_path(path, sizeof(path), job->chunk_dir, chunk->hex);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        ssize_t n = fd >= 0 && chunk->length <= CHUNK_MAX_BYTES ? read(fd, buffer, chunk->length) : -1;
+        if (fd >= 0) close(fd);
         
-        if (value < min_val || value > max_val) {
-            printf(YELLOW "⚠️  Value must be between %d and %d.\n" RESET, min_val, max_val);
+        int ok = n == (ssize_t)chunk->length;
+        if (ok) {
+            sha256_hex(buffer, chunk->length, hex);
+            ok = strcmp(hex, chunk->hex) == 0;
         }
-    } while (value < min_val || value > max_val);
+        ok = ok && pwrite(job->fds[chunk->file], buffer, chunk->length, chunk->offset) == n;
+        if (!ok) {
+            fprintf(stderr, "Chunk %s is missing or damaged\n", chunk->hex);
+            atomic_store(&job->failed, 1);
+        }
+        atomic_fetch_add(&job->bytes, chunk->length);
+    }
+    free(buffer);
+    return NULL;
+}
+
+// Rebuilds the data files a manifest describes at equipment_path and
+// request_path, reading and verifying chunks on `threads` threads. Each
+// output is written under a temporary name and renamed only when every
+// chunk checked out; before_replace (if set) sees each target just before
+// that. Returns the bytes restored, or -1 on failure.
+long long restore_backup_files(const char* manifest_path, const char* equipment_path,
+                               const char* request_path, int threads,
+                               void (*before_replace)(const char* path)) {
+    Manifest manifest;
+    if (!read_manifest(manifest_path, &manifest)) {
+        fprintf(stderr, "Manifest %s is missing or incomplete\n", manifest_path);
+        return -1;
+    }
+    
+    char chunk_dir[192];
+    const char* slash = strrchr(manifest_path, '/');
+    snprintf(chunk_dir, sizeof(chunk_dir), "%.*s/chunks",
+             slash ? (int)(slash - manifest_path) : 1, slash ? manifest_path : ".");
     
-    return value;
+    ChunkRestore job = {.manifest = &manifest, .chunk_dir = chunk_dir, .fds = {-1, -1}};
+    const char* targets[2];
+    char temps[2][256];
+    int ok = 1;
+    for (int f = 0; f < manifest.file_count && ok; f++) {
+        targets[f] = strcmp(manifest.files[f].name, REQUEST_FILE) == 0 ? request_path : equipment_path;
+        snprintf(temps[f], sizeof(temps[f]), "%s.tmp", targets[f]);
+        job.fds[f] = open(temps[f], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ok = job.fds[f] >= 0 && ftruncate(job.fds[f], manifest.files[f].size) == 0;
+    }
+    
+    if (threads < 1) threads = 1;
+    if (threads > RESTORE_MAX_THREADS) threads = RESTORE_MAX_THREADS;
+    pthread_t workers[RESTORE_MAX_THREADS];
+    int started = 0;
+    for (int t = 0; ok && t < threads; t++) {
+        if (pthread_create(&workers[t], NULL, chunk_restore_main, &job) == 0) started++;
+    }
+    if (ok && started == 0) chunk_restore_main(&job);
+    for (int t = 0; t < started; t++) pthread_join(workers[t], NULL);
+    ok = ok && !atomic_load(&job.failed);
+    
+    for (int f = 0; f < manifest.file_count; f++) {
+        if (job.fds[f] < 0) continue;
+        if (ok && fsync(job.fds[f]) != 0) ok = 0;
+        close(job.fds[f]);
+    }
+    for (int f = 0; f < manifest.file_count; f++) {
+        if (ok && before_replace) before_replace(targets[f]);
+        if (ok) ok = rename(temps[f], targets[f]) == 0;
+        else unlink(temps[f]);
+    }
+    free(manifest.chunks);
+    return ok ? atomic_load(&job.bytes) : -1;
 }
 
-void log_action(const char* action) {
-    FILE* log = fopen(LOG_FILE, "a");
-    if (log) {
-        time_t now = time(NULL);
-        char* time_str = ctime(&now);
-        time_str[strlen(time_str) - 1] = 0;
-        fprintf(log, "[%s] %s\n", time_str, action);
-        fclose(log);
+// Newest manifest in dir, by its timestamped name
+int latest_backup_manifest(const char* dir, char* out, size_t size) {
+    DIR* handle = opendir(dir);
+    if (!handle) return 0;
+    char best[128] = "";
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (strncmp(entry->d_name, "backup-", 7) == 0 && length > 9 && length < sizeof(best) &&
+            strcmp(entry->d_name + length - 9, ".manifest") == 0 && strcmp(entry->d_name, best) > 0) {
+            strcpy(best, entry->d_name);
+        }
+    }
+    closedir(handle);
+    if (!best[0]) return 0;
+    snprintf(out, size, "%s/%s", dir, best);
+    return 1;
+}
+
+// Reads the counters a backup child left on its manifest's stats line
+int read_backup_stats(const char* path, BackupStats* stats) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    char line[256];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file)) {
+        found = sscanf(line, "stats %ld %ld %lld %lld", &stats->chunks, &stats->new_chunks,
+                       &stats->new_bytes, &stats->total_bytes) == 4;
     }
+    fclose(file);
+    return found;
+}
+
+// ----------------------------------------------------------------------------
+// Snapshots, hot backups and point-in-time restore
+// ----------------------------------------------------------------------------
+
+void snapshot_path(char* out, size_t size, const char* dir, long long taken_us) {
+    snprintf(out, size, "%s/snapshot-%016lld.snap", dir, taken_us);
+}
+
+int compare_long_longs(const void* a, const void* b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Lists the snapshot times in dir, oldest first. Returns the count, or -1
+// when dir cannot be read.
+int list_snapshots(const char* dir, long long** times) {
+    *times = NULL;
+    DIR* handle = opendir(dir);
+    if (!handle) return -1;
     
-    if (use_database) {
-        log_to_database(action);
+    int count = 0, capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        long long taken_us;
+        int used = 0;
+        if (sscanf(entry->d_name, "snapshot-%lld%n", &taken_us, &used) != 1 ||
+            strcmp(entry->d_name + used, ".snap") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            long long* grown = realloc(*times, capacity * sizeof(long long));
+            if (!grown) break;
+            *times = grown;
+        }
+        (*times)[count++] = taken_us;
     }
+    closedir(handle);
+    
+    if (count) qsort(*times, count, sizeof(long long), compare_long_longs);
+    return count;
 }
 
-int calculate_checksum(const Equipment* item) {
-    int sum = item->id + item->quantity + item->min_threshold;
-    for (int i = 0; item->name[i]; i++) {
-        sum += item->name[i];
+// Writes the current arrays as a snapshot stamped taken_us. Allocation
+// free, so a forked child can run it on its frozen image.
+int write_snapshot_file(const char* path, long long taken_us) {
+    size_t item_bytes = item_count * sizeof(Equipment);
+    size_t request_bytes = request_count * sizeof(SupplyRequest);
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.taken_us = taken_us;
+    header.item_count = item_count;
+    header.next_item_id = next_item_id;
+    header.request_count = request_count;
+    header.next_request_id = next_request_id;
+    header.item_size = sizeof(Equipment);
+    header.request_size = sizeof(SupplyRequest);
+    header.crc = crc32(crc32(0L, (const Bytef*)inventory, item_bytes),
+                       (const Bytef*)requests, request_bytes);
+    
+    struct iovec parts[3] = {
+        {&header, sizeof(header)}, {inventory, item_bytes}, {requests, request_bytes}
+    };
+    return write_parts_atomic(path, parts, 3);
+}
+
+void prune_snapshots(void) {
+    long long* times;
+    int count = list_snapshots(db_config.snapshot_dir, &times);
+    char path[192];
+    for (int i = 0; db_config.snapshot_keep > 0 && i < count - db_config.snapshot_keep; i++) {
+        snapshot_path(path, sizeof(path), db_config.snapshot_dir, times[i]);
+        remove(path);
     }
-    return sum % 10000;
+    free(times);
 }
 
-void display_equipment_details(const Equipment* item) {
-    StockStatus status = get_stock_status(item);
+static void finish_forked_copy(CopyKind kind, const char* path, int ok, long long elapsed_us) {
+    char message[MAX_LOG_MSG_LEN];
+    snprintf(message, sizeof(message), "%s %s %s in %.1f ms (foreground stall %lld us)",
+             kind == COPY_SNAPSHOT ? "Snapshot" : "Backup", path, ok ? "written" : "failed",
+             elapsed_us / 1000.0, forked_copy.stall_us);
+    log_event(ok ? LOG_INFO : LOG_WARNING, message);
+    if (ok && kind == COPY_SNAPSHOT) prune_snapshots();
     
-    display_classification_banner(item->classification);
+    BackupStats stats;
+    if (ok && kind == COPY_BACKUP && read_backup_stats(path, &stats)) {
+        snprintf(message, sizeof(message), "Backup stored %ld of %ld chunks (%lld of %lld bytes)",
+                 stats.new_chunks, stats.chunks, stats.new_bytes, stats.total_bytes);
+        log_event(LOG_INFO, message);
+    }
+}
+
+// Forks a child that writes the arrays through write_image while the
+// parent carries on. Parent and child share pages until the parent writes
+// to one, so the child sees the arrays exactly as they were at fork() and
+// the foreground only pays for the fork. Writes inline if fork() fails.
+// Returns 0 when a copy is already running or the inline write failed.
+int start_forked_copy(CopyKind kind, const char* path, ImageWriter write_image, long long taken_us) {
+    if (forked_copy.pid) return 0;
     
-    printf(BOLD WHITE "📦 EQUIPMENT DETAILS\n" RESET);
+    long long started = now_us();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The child has only this thread; it must not touch the loggers,
+        // the ring or stdio buffers it inherited, hence _exit()
+        setpriority(PRIO_PROCESS, 0, 10);
+        _exit(write_image(path, taken_us) ? 0 : 1);
+    }
+    forked_copy.stall_us = now_us() - started;
+    
+    if (pid < 0) {
+        int ok = write_image(path, taken_us);
+        forked_copy.stall_us = now_us() - started;
+        finish_forked_copy(kind, path, ok, forked_copy.stall_us);
+        return ok;
+    }
+    
+    forked_copy.pid = pid;
+    forked_copy.kind = kind;
+    forked_copy.started_us = started;
+    snprintf(forked_copy.path, sizeof(forked_copy.path), "%s", path);
+    return 1;
+}
+
+// Collects the running copy's exit status, blocking only when wait is set.
+// Returns 1 once no copy is running.
+int reap_forked_copy(int wait) {
+    if (!forked_copy.pid) return 1;
+    
+    int status;
+    pid_t done = waitpid(forked_copy.pid, &status, wait ? 0 : WNOHANG);
+    if (done == 0 || (done < 0 && errno == EINTR)) return 0;
+    
+    forked_copy.pid = 0;
+    int ok = done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    finish_forked_copy(forked_copy.kind, forked_copy.path, ok, now_us() - forked_copy.started_us);
+    return 1;
+}
+
+// Snapshots inventory[] and requests[] and prunes the oldest beyond
+// snapshot_keep. It runs on the thread that changes the arrays, so the
+// copy holds exactly the audit events stamped before taken_us. In the
+// background a forked child does the writing; a snapshot due while a
+// backup is still running waits for the next timer tick.
+int take_snapshot(int background) {
+    if (background && forked_copy.pid) return 0;
+    last_snapshot = time(NULL);
+    if (mkdir(db_config.snapshot_dir, 0755) != 0 && errno != EEXIST) return 0;
+    
+    long long taken_us = wall_clock_us();
+    char path[192];
+    snapshot_path(path, sizeof(path), db_config.snapshot_dir, taken_us);
+    if (background) return start_forked_copy(COPY_SNAPSHOT, path, write_snapshot_file, taken_us);
+    
+    int ok = write_snapshot_file(path, taken_us);
+    if (ok) prune_snapshots();
+    else log_event(LOG_WARNING, "Snapshot write failed");
+    return ok;
+}
+
+// Menu command: starts a backup to backup_path/backup-YYYYMMDD-HHMMSS.manifest
+// without pausing the operator
+void backup_inventory(void) {
+    display_banner();
+    printf(BOLD YELLOW "💾 HOT BACKUP\n" RESET);
     printf("════════════════════════════════════════════════════════════════════════════════\n");
-    printf(CYAN "ID: " WHITE "%d\n" RESET, item->id);
-    printf(CYAN "Name: " WHITE "%s\n" RESET, item->name);
-    printf(CYAN "Description: " WHITE "%s\n" RESET, item->description);
-    printf(CYAN "Quantity: " WHITE "%d %s\n" RESET, item->quantity, item->unit);
-    printf(CYAN "Location: " WHITE "%s\n" RESET, item->location);
-    printf(CYAN "Min Threshold: " WHITE "%d\n" RESET, item->min_threshold);
     
-    switch (status) {
-        case STATUS_LOW:
-            printf(BOLD RED "🚨 STATUS: *** LOW STOCK - RESUPPLY REQUIRED ***\n" RESET);
-            break;
-        case STATUS_WATCH:
-            printf(BOLD YELLOW "⚠️  STATUS: CAUTION - Monitor stock levels\n" RESET);
-            break;
-        case STATUS_OK:
-            printf(BOLD GREEN "✅ STATUS: ADEQUATE\n" RESET);
+    // A snapshot child only needs milliseconds; let it finish first
+    reap_forked_copy(1);
+    
+    char stamp[32], path[192];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(path, sizeof(path), "%s/backup-%s.manifest", db_config.backup_path, stamp);
+    if (mkdir(db_config.backup_path, 0755) != 0 && errno != EEXIST) {
+        printf(RED "❌ Cannot create %s: %s\n" RESET, db_config.backup_path, strerror(errno));
+        wait_for_enter();
+        return;
+    }
+    
+    if (!start_forked_copy(COPY_BACKUP, path, write_backup_manifest, wall_clock_us())) {
+        printf(RED "❌ Backup to %s failed.\n" RESET, path);
+    } else {
+        printf(GREEN "✅ Backup of %d items and %d requests %s %s\n" RESET, item_count, request_count,
+               forked_copy.pid ? "is being written to" : "written to", path);
+        printf(CYAN "   Foreground stall: " WHITE "%lld µs\n" RESET, forked_copy.stall_us);
+    }
+    wait_for_enter();
+}
+
+// Loads a snapshot into inventory[] and requests[] after checking its
+// layout and CRC. Returns 0 and leaves the counts alone if it is damaged.
+int load_snapshot(const char* dir, long long taken_us) {
+    char path[192];
+    snapshot_path(path, sizeof(path), dir, taken_us);
+    size_t size;
+    const uint8_t* data = map_file(path, &size);
+    if (!data) return 0;
+    
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    size_t item_bytes = 0, request_bytes = 0;
+    int ok = size >= sizeof(*header) && memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+             header->item_size == sizeof(Equipment) && header->request_size == sizeof(SupplyRequest) &&
+             header->item_count >= 0 && header->item_count <= MAX_ITEMS &&
+             header->request_count >= 0 && header->request_count <= MAX_REQUESTS;
+    if (ok) {
+        item_bytes = header->item_count * sizeof(Equipment);
+        request_bytes = header->request_count * sizeof(SupplyRequest);
+        ok = size == sizeof(*header) + item_bytes + request_bytes;
+    }
+    if (ok) {
+        // The workers copy and checksum the items; the CRC covers both
+        // arrays, so their part is combined with the requests'. The index
+        // is left to whatever replay follows.
+        LoadStats stats;
+        load_equipment_records((const Equipment*)(data + sizeof(*header)), header->item_count, LOAD_VERIFY, 0,
+                               &stats);
+        memcpy(requests, data + sizeof(*header) + item_bytes, request_bytes);
+        uLong crc = crc32_z(0L, (const Bytef*)requests, request_bytes);
+        ok = crc32_combine(stats.crc, crc, request_bytes) == header->crc;
+        if (ok) {
+            item_count = header->item_count;
+            next_item_id = header->next_item_id;
+            request_count = header->request_count;
+            next_request_id = header->next_request_id;
+            if (stats.mismatches) {
+                fprintf(stderr, "Snapshot %lld: %d equipment records failed checksum verification (first ID %d)\n",
+                        taken_us, stats.mismatches, stats.first_mismatch_id);
+            }
+        }
+    }
+    munmap((void*)data, size);
+    return ok;
+}
+
+// Rebuilds the state as of until_us (0 = the end of the journal): the
+// newest intact snapshot taken at or before it, plus the audit events
+// after that. *from_us receives the snapshot used (0 = none, replayed from
+// empty). Returns the replay status.
+int restore_state(long long until_us, long long* from_us, AuditQueryStats* stats) {
+    item_count = 0;
+    request_count = 0;
+    next_item_id = 1;
+    next_request_id = 1;
+    *from_us = 0;
+    
+    long long* times;
+    int count = list_snapshots(db_config.snapshot_dir, &times);
+    for (int i = count - 1; i >= 0; i--) {
+        if (until_us && times[i] > until_us) continue;
+        if (load_snapshot(db_config.snapshot_dir, times[i])) {
+            *from_us = times[i];
             break;
+        }
+        fprintf(stderr, "Skipping damaged snapshot %lld\n", times[i]);
     }
+    free(times);
     
-    printf(CYAN "Last Updated: " WHITE "%s" RESET, ctime(&item->last_updated));
-    printf(CYAN "Checksum: " WHITE "%s\n" RESET, item->checksum);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    // Retention removes the oldest segments; if the survivors begin after
+    // the snapshot, whatever happened in between is gone
+    int* sequences;
+    int segments = list_audit_segments(db_config.audit_dir, &sequences);
+    if (segments > 0 && sequences[0] > 1 &&
+        audit_segment_first_us(db_config.audit_dir, sequences[0]) > *from_us) {
+        fprintf(stderr, "Warning: the journal starts after the snapshot; earlier events were "
+                        "deleted by audit_retention_days\n");
+    }
+    free(sequences);
+    
+    return replay_audit_events(db_config.audit_dir, *from_us ? *from_us + 1 : 0, until_us, stats);
 }
 
-void display_equipment_table_header(void) {
-    printf(BOLD WHITE);
-    printf("┌──────┬──────────────────────┬──────────┬────────┬─────────────────┬────────────┐\n");
-    printf("│ %-4s │ %-20s │ %-8s │ %-6s │ %-15s │ %-10s │\n", 
-           "ID", "NAME", "QTY", "UNIT", "LOCATION", "STATUS");
-    printf("├──────┼──────────────────────┼──────────┼────────┼─────────────────┼────────────┤\n");
-    printf(RESET);
+// Keeps a data file as <path>.pre-restore before restore replaces it.
+// A file restore is about to rewrite in place has to be moved aside; one
+// that will be replaced by rename() can stay where it is, hard-linked.
+// Either way an older .pre-restore is only replaced once the new copy exists.
+static void keep_pre_restore_copy(const char* path, int replaced_by_rename) {
+    char saved[192], linked[200];
+    snprintf(saved, sizeof(saved), "%s.pre-restore", path);
+    int kept;
+    if (replaced_by_rename) {
+        snprintf(linked, sizeof(linked), "%s.tmp", saved);
+        unlink(linked);
+        kept = link(path, linked) == 0 && rename(linked, saved) == 0;
+    } else {
+        kept = rename(path, saved) == 0;
+    }
+    if (kept) printf("Previous %s kept as %s\n", path, saved);
 }
 
-void display_equipment_row(const Equipment* item) {
-    StockStatus status = get_stock_status(item);
-    const char* status_color = (status == STATUS_LOW) ? RED : 
-                              (status == STATUS_WATCH) ? YELLOW : GREEN;
+static void keep_replaced_backup_target(const char* path) {
+    keep_pre_restore_copy(path, 1);
+}
+
+// --restore [--to TIME] [--dry-run]
+// Writes the restored state to the local data files (data_file and
+// request_file); the files it replaces are kept with a .pre-restore suffix
+int run_restore(int argc, char** argv) {
+    long long until_us = 0;
+    int dry_run = 0;
     
-    printf("│ %-4d │ %-20s │ %s%-8d%s │ %-6s │ %-15s │ %s%-10s%s │\n",
-           item->id, item->name, WHITE, item->quantity, RESET,
-           item->unit, item->location, status_color, STOCK_STATUS_NAMES[status], RESET);
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            until_us = parse_audit_time(argv[++i]);
+            if (until_us < 0) {
+                fprintf(stderr, "Cannot parse time '%s'\n", argv[i]);
+                return 1;
+            }
+            until_us += 999999;
+        } else if (strcmp(argv[i], "--dry-run") == 0) {
+            dry_run = 1;
+        } else {
+            fprintf(stderr, "Usage: --restore [--to TIME] [--dry-run]\n");
+            return 1;
+        }
+    }
+    
+    load_db_config();
+    AuditQueryStats stats;
+    long long from_us;
+    long long started = now_us();
+    int status = restore_state(until_us, &from_us, &stats);
+    long long elapsed_us = now_us() - started;
+    if (status < 0 && stats.segments > 0) {
+        fprintf(stderr, "Truncated record in the journal; state is as of the last whole record\n");
+    }
+    
+    char when[40] = "end of journal", base[40] = "empty state";
+    if (until_us) format_audit_time(until_us, when, sizeof(when));
+    if (from_us) format_audit_time(from_us, base, sizeof(base));
+    printf("Restored %d equipment items and %d requests as of %s\n", item_count, request_count, when);
+    printf("Base snapshot: %s; %ld journal events replayed from %ld blocks in %.2f ms\n",
+           base, replay_state.applied, stats.blocks_read, elapsed_us / 1000.0);
+    if (dry_run) return 0;
+    
+    keep_pre_restore_copy(db_config.data_file, 0);
+    keep_pre_restore_copy(db_config.request_file, 0);
+    storage = &FILE_ENGINE;
+    storage->open();
+    if (!storage->flush()) {
+        fprintf(stderr, "Cannot write %s or %s\n", db_config.data_file, db_config.request_file);
+        return 1;
+    }
+    printf("Wrote %s and %s\n", db_config.data_file, db_config.request_file);
+    if (strcmp(db_config.storage_engine, "file") != 0) {
+        printf("Note: storage_engine is %s; the restored state is in the local files only\n",
+               db_config.storage_engine);
+    }
+    return 0;
 }
 
-void display_equipment_table_footer(int count) {
-    printf("└──────┴──────────────────────┴──────────┴────────┴─────────────────┴────────────┘\n");
-    printf(BOLD CYAN "Total Equipment Items: %d\n" RESET, count);
+// --restore-backup [MANIFEST] [--threads N]
+// Rebuilds data_file and request_file from a backup, the newest in
+// backup_path by default
+int run_restore_backup(int argc, char** argv) {
+    const char* name = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            name = argv[i];
+        } else {
+            fprintf(stderr, "Usage: --restore-backup [MANIFEST] [--threads N]\n");
+            return 1;
+        }
+    }
+    
+    load_db_config();
+    char path[256];
+    if (!name) {
+        if (!latest_backup_manifest(db_config.backup_path, path, sizeof(path))) {
+            fprintf(stderr, "No backups in %s\n", db_config.backup_path);
+            return 1;
+        }
+    } else if (strchr(name, '/') || access(name, F_OK) == 0) {
+        snprintf(path, sizeof(path), "%s", name);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s", db_config.backup_path, name);
+    }
+    
+    long long started = now_us();
+    long long bytes = restore_backup_files(path, db_config.data_file, db_config.request_file, (int)threads,
+                                           keep_replaced_backup_target);
+    long long elapsed_us = now_us() - started;
+    if (bytes < 0) {
+        fprintf(stderr, "Restore from %s failed; the data files were not changed\n", path);
+        return 1;
+    }
+    
+    printf("Restored %s and %s from %s: %.1f KB in %.2f ms on %ld threads\n", db_config.data_file,
+           db_config.request_file, path, bytes / 1024.0, elapsed_us / 1000.0,
+           threads < 1 ? 1 : threads > RESTORE_MAX_THREADS ? RESTORE_MAX_THREADS : threads);
+    return 0;
 }
 
 // ============================================================================
-// DATA PERSISTENCE
+// BENCHMARKS
 // ============================================================================
 
-void load_data(void) {
-    if (use_database) {
-        load_equipment_from_db();
-        load_requests_from_db();
-    } else {
-        FILE* file = fopen(DATA_FILE, "rb");
-        if (file) {
-            fread(&item_count, sizeof(int), 1, file);
-            fread(&next_item_id, sizeof(int), 1, file);
-            fread(inventory, sizeof(Equipment), item_count, file);
-            fclose(file);
+#define BENCH_HOT_ITEMS 8
+
+// Simulates a stock count: the same few items are updated over and over,
+// first with one synchronous UPDATE and audit insert per call, then
+// through the write-behind cache.
+void benchmark_updates(int iterations) {
+    open_storage();
+    if (!use_database || item_count == 0) {
+        printf(RED "❌ The update benchmark needs a database with at least one item.\n" RESET);
+        close_storage();
+        return;
+    }
+    
+    int hot = item_count < BENCH_HOT_ITEMS ? item_count : BENCH_HOT_ITEMS;
+    int original[BENCH_HOT_ITEMS];
+    for (int i = 0; i < hot; i++) original[i] = inventory[i].quantity;
+    int configured_mode = db_config.write_behind;
+    
+    printf(BOLD WHITE "Repeated-update workload: %d updates over %d items\n" RESET,
+           iterations, hot);
+    
+    for (int mode = 0; mode < 2; mode++) {
+        db_config.write_behind = mode;
+        long flushes_before = write_behind.flushes;
+        long long started = now_ms();
+        
+        for (int i = 0; i < iterations; i++) {
+            Equipment* item = &inventory[i % hot];
+            item->quantity = original[i % hot] + i % 7;
+            sprintf(item->checksum, "%04d", calculate_checksum(item));
             
-            for (int i = 0; i < item_count; i++) {
-                hash_insert(&inventory[i]);
+            char log_msg[MAX_LOG_MSG_LEN];
+            snprintf(log_msg, sizeof(log_msg), "Benchmark update %s quantity: %d",
+                     item->name, item->quantity);
+            if (mode) {
+                write_behind_queue_update(item);
+                log_to_database(log_msg);
+                write_behind_tick();
+            } else {
+                update_equipment_in_db(item);
+                log_to_database(log_msg);
             }
-            printf(GREEN "📁 Loaded %d equipment items from local files.\n" RESET, item_count);
         }
+        if (mode) write_behind_flush();
         
-        file = fopen(REQUEST_FILE, "rb");
-        if (file) {
-            fread(&request_count, sizeof(int), 1, file);
-            fread(&next_request_id, sizeof(int), 1, file);
-            fread(requests, sizeof(SupplyRequest), request_count, file);
-            fclose(file);
-            printf(GREEN "📋 Loaded %d supply requests from local files.\n" RESET, request_count);
-        }
+        long long elapsed = now_ms() - started;
+        long round_trips = mode ? write_behind.flushes - flushes_before : 2L * iterations;
+        printf(CYAN "  %-13s" WHITE " %8lld ms  %10.0f updates/s  %8ld round trips\n" RESET,
+               mode ? "write-behind" : "synchronous", elapsed,
+               elapsed > 0 ? iterations * 1000.0 / elapsed : 0.0, round_trips);
+    }
+    
+    db_config.write_behind = 0;
+    for (int i = 0; i < hot; i++) {
+        inventory[i].quantity = original[i];
+        sprintf(inventory[i].checksum, "%04d", calculate_checksum(&inventory[i]));
+        update_equipment_in_db(&inventory[i]);
     }
+    db_config.write_behind = configured_mode;
+    close_storage();
 }
 
-void save_data(void) {
-    if (!use_database) {
-        FILE* file = fopen(DATA_FILE, "wb");
-        if (file) {
-            fwrite(&item_count, sizeof(int), 1, file);
-            fwrite(&next_item_id, sizeof(int), 1, file);
-            fwrite(inventory, sizeof(Equipment), item_count, file);
-            fclose(file);
+typedef struct {
+    int visited;
+    long long quantity_total;
+} ScanTally;
+
+static int tally_equipment(const Equipment* item, void* ctx) {
+    ScanTally* tally = ctx;
+    tally->visited++;
+    tally->quantity_total += item->quantity;
+    return 1;
+}
+
+// Runs one insert/update/flush/scan/delete workload against every engine.
+// The file engine writes to scratch files and the PostgreSQL engine
+// deletes every row it inserted, so live data is left untouched.
+void benchmark_engines(int iterations) {
+    load_db_config();
+    strcpy(db_config.data_file, "bench_equipment.dat");
+    strcpy(db_config.request_file, "bench_requests.dat");
+    strcpy(db_config.db_path, "bench_inventory.db");
+    remove("bench_inventory.db");
+    if (iterations > MAX_ITEMS) iterations = MAX_ITEMS;
+    
+    printf(BOLD WHITE "Storage engine workload: %d items\n" RESET, iterations);
+    printf(BOLD WHITE "  %-10s %10s %10s %10s %10s %10s %12s\n" RESET,
+           "ENGINE", "INSERT us", "UPDATE us", "FLUSH us", "SCAN us", "DELETE us", "BYTES OUT");
+    
+    for (int e = 0; e < STORAGE_ENGINE_COUNT; e++) {
+        storage = STORAGE_ENGINES[e];
+        item_count = 0;
+        next_item_id = 1;
+        hash_clear();
+        
+        if ((storage == &POSTGRES_ENGINE && !db_config.host[0]) || !storage->open()) {
+            printf(YELLOW "  %-10s skipped (unavailable)\n" RESET, storage->name);
+            continue;
+        }
+        use_database = storage == &POSTGRES_ENGINE;
+        
+        long long phase_us[5];
+        long long started = now_us();
+        for (int i = 0; i < iterations; i++) {
+            Equipment* item = &inventory[item_count];
+            memset(item, 0, sizeof(Equipment));
+            item->id = next_item_id++;
+            snprintf(item->name, MAX_NAME_LEN, "Bench item %d", i);
+            strcpy(item->unit, "ea");
+            strcpy(item->location, "Bench");
+            item->quantity = i;
+            item->min_threshold = i % 10;
+            item->last_updated = time(NULL);
+            sprintf(item->checksum, "%04d", calculate_checksum(item));
+            storage->insert_equipment(item);
+            hash_insert(item);
+            item_count++;
+        }
+        phase_us[0] = now_us() - started;
+        
+        started = now_us();
+        for (int i = 0; i < item_count; i++) {
+            inventory[i].quantity++;
+            sprintf(inventory[i].checksum, "%04d", calculate_checksum(&inventory[i]));
+            storage->update_equipment(&inventory[i]);
+        }
+        phase_us[1] = now_us() - started;
+        
+        started = now_us();
+        storage->flush();
+        phase_us[2] = now_us() - started;
+        
+        ScanTally tally = {0, 0};
+        started = now_us();
+        storage->scan_equipment(tally_equipment, &tally);
+        phase_us[3] = now_us() - started;
+        
+        started = now_us();
+        for (int i = 0; i < item_count; i++) {
+            storage->delete_equipment(inventory[i].id);
         }
+        item_count = 0;
+        hash_clear();
+        storage->flush();
+        phase_us[4] = now_us() - started;
         
-        file = fopen(REQUEST_FILE, "wb");
-        if (file) {
-            fwrite(&request_count, sizeof(int), 1, file);
-            fwrite(&next_request_id, sizeof(int), 1, file);
-            fwrite(requests, sizeof(SupplyRequest), request_count, file);
-            fclose(file);
+        StorageStats stats;
+        storage->stats(&stats);
+        printf(CYAN "  %-10s" WHITE " %10lld %10lld %10lld %10lld %10lld %12lld\n" RESET,
+               storage->name, phase_us[0], phase_us[1], phase_us[2], phase_us[3],
+               phase_us[4], stats.bytes_written);
+        if (tally.visited != iterations) {
+            printf(YELLOW "  %-10s scan returned %d of %d items\n" RESET,
+                   storage->name, tally.visited, iterations);
         }
-        printf(GREEN "💾 Data saved to local files.\n" RESET);
+        
+        storage->close();
     }
+    
+    storage = NULL;
+    use_database = 0;
+    remove("bench_equipment.dat");
+    remove("bench_requests.dat");
+    remove("bench_inventory.db");
+    remove("bench_inventory.db-wal");
+    remove("bench_inventory.db-shm");
 }
 
-// ============================================================================
-// ENHANCED CORE FUNCTIONALITY
-// ============================================================================
+#define BENCH_LOG_FILE "bench_equipment.log"
+#define BENCH_FSYNC_ALWAYS_MAX 2000
 
-void display_menu(void) {
-    display_banner();
-    
-    printf(BOLD WHITE "🎯 MISSION COMMANDS:\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    printf(GREEN "  [1]" WHITE " 📦 Add Equipment          " GREEN "[2]" WHITE " 🔍 Check Inventory\n");
-    printf(GREEN "  [3]" WHITE " 📋 List All Equipment     " GREEN "[4]" WHITE " 📊 Update Quantity\n");
-    printf(GREEN "  [5]" WHITE " 📝 Request Supply         " GREEN "[6]" WHITE " 📑 Check Requests\n");
-    printf(GREEN "  [7]" WHITE " 🚨 Low Stock Alert        " GREEN "[8]" WHITE " 📄 Export Report\n");
-    printf(GREEN "  [9]" WHITE " 🚪 Exit System\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    display_command_prompt();
+void report_logger_bench(const char* name, int lines, long long elapsed_us,
+                         long writes, long fsyncs) {
+    printf(CYAN "  %-18s" WHITE " %8d lines %10.1f ms %12.0f lines/s %8ld writes %8ld fsyncs\n" RESET,
+           name, lines, elapsed_us / 1000.0,
+           elapsed_us > 0 ? lines * 1000000.0 / elapsed_us : 0.0, writes, fsyncs);
 }
 
-void add_equipment(void) {
-    display_banner();
-    printf(BOLD YELLOW "📦 ADD NEW EQUIPMENT\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
+// Compares the old open/format/close-per-line logging with the buffered
+// logger under each fsync policy. fsync-per-line is capped since it is
+// bounded by the disk's flush latency.
+void benchmark_logger(int iterations) {
+    char message[MAX_LOG_MSG_LEN];
+    printf(BOLD WHITE "Action log workload: %d lines\n" RESET, iterations);
     
-    if (item_count >= MAX_ITEMS) {
-        printf(RED "❌ ERROR: Maximum equipment limit reached.\n" RESET);
-        wait_for_enter();
-        return;
+    remove(BENCH_LOG_FILE);
+    long long started = now_us();
+    for (int i = 0; i < iterations; i++) {
+        snprintf(message, sizeof(message), "Updated Bench item %d quantity: %d -> %d", i % 97, i, i + 1);
+        FILE* log = fopen(BENCH_LOG_FILE, "a");
+        if (!log) break;
+        time_t now = time(NULL);
+        char* time_str = ctime(&now);
+        time_str[strlen(time_str) - 1] = 0;
+        fprintf(log, "[%s] %s\n", time_str, message);
+        fclose(log);
     }
+    report_logger_bench("fopen per line", iterations, now_us() - started, iterations, 0);
     
-    Equipment* item = &inventory[item_count];
-    item->id = next_item_id++;
-    
-    get_string_input("Equipment Name: ", item->name, MAX_NAME_LEN);
-    get_string_input("Description: ", item->description, MAX_DESC_LEN);
-    
-    item->quantity = get_int_input("Initial Quantity: ", 0, 999999);
-    item->min_threshold = get_int_input("Minimum Threshold: ", 0, 999999);
+    const char* policy_names[] = {"buffered, none", "buffered, interval", "buffered, always"};
+    for (int policy = FSYNC_NONE; policy <= FSYNC_ALWAYS; policy++) {
+        remove(BENCH_LOG_FILE);
+        Logger* logger = malloc(sizeof(Logger));
+        if (!logger || !logger_open(logger, BENCH_LOG_FILE, policy, DEFAULT_LOG_FLUSH_MS)) {
+            printf(RED "❌ Cannot open %s\n" RESET, BENCH_LOG_FILE);
+            free(logger);
+            break;
+        }
+        
+        int lines = policy == FSYNC_ALWAYS && iterations > BENCH_FSYNC_ALWAYS_MAX
+                    ? BENCH_FSYNC_ALWAYS_MAX : iterations;
+        started = now_us();
+        for (int i = 0; i < lines; i++) {
+            snprintf(message, sizeof(message), "Updated Bench item %d quantity: %d -> %d", i % 97, i, i + 1);
+            logger_write(logger, LOG_INFO, message);
+            logger_tick(logger);
+        }
+        logger_close(logger);
+        report_logger_bench(policy_names[policy], lines, now_us() - started,
+                            logger->writes, logger->fsyncs);
+        free(logger);
+    }
+    remove(BENCH_LOG_FILE);
+}
+
+#define BENCH_AUDIT_DIR "bench_audit"
+#define BENCH_AUDIT_TEXT_FILE "bench_audit.txt"
+#define BENCH_DECODE_MIN_US 200000
+
+long long file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+// Deletes the files in dir whose names start with prefix, then dir itself
+void remove_dir_files(const char* dir, const char* prefix) {
+    DIR* handle = opendir(dir);
+    if (!handle) return;
+    struct dirent* entry;
+    char path[512];
+    while ((entry = readdir(handle)) != NULL) {
+        if (strncmp(entry->d_name, prefix, strlen(prefix)) != 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        remove(path);
+    }
+    closedir(handle);
+    rmdir(dir);
+}
+
+void remove_audit_dir(const char* dir) {
+    remove_dir_files(dir, "segment-");
+}
+
+void remove_snapshot_dir(const char* dir) {
+    remove_dir_files(dir, "snapshot-");
+}
+
+// Sums the sizes of one kind of segment file ("audit", "tidx" or "iidx")
+long long audit_dir_bytes(const char* dir, const char* ext) {
+    int* sequences;
+    int count = list_audit_segments(dir, &sequences);
+    long long total = 0;
+    char path[192];
+    for (int i = 0; i < count; i++) {
+        audit_segment_path(path, sizeof(path), dir, sequences[i], ext);
+        total += file_size(path);
+    }
+    free(sequences);
+    return total;
+}
+
+// Repeats one query for at least BENCH_DECODE_MIN_US and prints its cost
+void benchmark_audit_query(const char* label, const AuditFilter* filter, int use_index) {
+    AuditQueryStats stats;
+    long passes = 0;
+    long long started = now_us(), elapsed;
+    do {
+        query_audit_dir(BENCH_AUDIT_DIR, filter, use_index, NULL, 0, &stats);
+        passes++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCH_DECODE_MIN_US);
     
-    get_string_input("Unit (ea, box, case, etc.): ", item->unit, MAX_UNIT_LEN);
-    get_string_input("Location: ", item->location, MAX_LOCATION_LEN);
+    printf(CYAN "  %-16s" WHITE " %10.3f ms/query  %6ld matches  %6ld of %ld blocks  %8.1f KB read\n" RESET,
+           label, elapsed / 1000.0 / passes, stats.matched, stats.blocks_read, stats.blocks,
+           stats.bytes_read / 1024.0);
+}
+
+// Writes the same event mix as binary records and as the old text lines,
+// decodes the binary log repeatedly to measure parse throughput, then
+// compares indexed lookups with full scans
+void benchmark_audit(int iterations) {
+    remove_audit_dir(BENCH_AUDIT_DIR);
+    remove(BENCH_AUDIT_TEXT_FILE);
     
-    item->classification = get_int_input(
-        "Classification (0=Unclass, 1=Restricted, 2=Confidential, 3=Secret): ", 
-        0, 3);
+    // Closed segments are only sealed while writing, so raw and compressed
+    // queries can be compared below
+    db_config.audit_compress = 0;
+    Logger* text_log = malloc(sizeof(Logger));
+    if (!text_log || !logger_open(text_log, BENCH_AUDIT_TEXT_FILE, FSYNC_NONE, DEFAULT_LOG_FLUSH_MS) ||
+        !audit_open(&audit_log, BENCH_AUDIT_DIR)) {
+        printf(RED "❌ Cannot create benchmark logs.\n" RESET);
+        free(text_log);
+        return;
+    }
     
-    item->last_updated = time(NULL);
-    sprintf(item->checksum, "%04d", calculate_checksum(item));
+    Equipment item = {0};
+    strcpy(item.name, "Bench item");
+    SupplyRequest req = {0};
+    char message[MAX_LOG_MSG_LEN];
+    long long window_us = 0, slowest_us = 0, slowest_roll_us = 0;
+    int sequence = audit_log.sequence, rolls = 0;
     
-    if (use_database) {
-        int db_id = add_equipment_to_db(item);
-        if (db_id > 0) {
-            item->id = db_id;
-            if (db_id >= next_item_id) {
-                next_item_id = db_id + 1;
-            }
+    long long started = now_us();
+    for (int i = 0; i < iterations; i++) {
+        if (i == iterations - iterations / 100 - 1) window_us = wall_clock_us();
+        item.id = i % 500 + 1;
+        item.quantity = i % 1000;
+        long long before = now_us();
+        switch (i % 20) {
+            case 0: case 1: case 2:
+                audit_add_equipment(&item);
+                snprintf(message, sizeof(message), "Added equipment: %s (ID: %d)", item.name, item.id);
+                break;
+            case 3: case 4:
+                req.req_id = i + 1;
+                req.equipment_id = item.id;
+                req.requested_qty = 25;
+                req.priority = PRIORITY_HIGH;
+                audit_supply_request(&req);
+                snprintf(message, sizeof(message), "Supply request created: REQ-%d for equipment ID %d",
+                         req.req_id, req.equipment_id);
+                break;
+            case 5:
+                audit_export(item.id);
+                snprintf(message, sizeof(message), "Inventory report exported");
+                break;
+            default:
+                audit_update_quantity(&item, item.quantity + 5);
+                snprintf(message, sizeof(message), "Updated %s quantity: %d -> %d",
+                         item.name, item.quantity + 5, item.quantity);
+                break;
+        }
+        long long took = now_us() - before;
+        if (took > slowest_us) slowest_us = took;
+        if (audit_log.sequence != sequence) {
+            sequence = audit_log.sequence;
+            rolls++;
+            if (took > slowest_roll_us) slowest_roll_us = took;
         }
+        logger_write(text_log, LOG_INFO, message);
     }
+    long long encode_us = now_us() - started;
+    audit_close(&audit_log);
+    audit_compressor_stop();
+    logger_close(text_log);
+    free(text_log);
     
-    hash_insert(item);
-    item_count++;
+    long long binary_bytes = audit_dir_bytes(BENCH_AUDIT_DIR, "audit");
+    long long index_bytes = audit_dir_bytes(BENCH_AUDIT_DIR, "tidx") + audit_dir_bytes(BENCH_AUDIT_DIR, "iidx") +
+                            audit_dir_bytes(BENCH_AUDIT_DIR, "sidx");
+    long long text_bytes = file_size(BENCH_AUDIT_TEXT_FILE);
+    printf(BOLD WHITE "Audit log workload: %d events\n" RESET, iterations);
+    printf(CYAN "  %-8s" WHITE " %12lld bytes %8.1f bytes/event\n" RESET, "text",
+           text_bytes, (double)text_bytes / iterations);
+    printf(CYAN "  %-8s" WHITE " %12lld bytes %8.1f bytes/event  (%.1fx smaller)\n" RESET, "binary",
+           binary_bytes, (double)binary_bytes / iterations,
+           binary_bytes ? (double)text_bytes / binary_bytes : 0.0);
+    printf(CYAN "  %-8s" WHITE " %12lld bytes %8.1f bytes/event  (time and item indexes)\n" RESET, "index",
+           index_bytes, (double)index_bytes / iterations);
+    printf(CYAN "  %-8s" WHITE " %12.1f ms   (binary and text together)\n" RESET, "encode",
+           encode_us / 1000.0);
+    printf(CYAN "  %-8s" WHITE " %12lld us   slowest event; slowest of %d segment rolls %lld us\n" RESET,
+           "append", slowest_us, rolls, slowest_roll_us);
     
-    char log_msg[256];
-    sprintf(log_msg, "Added equipment: %s (ID: %d)", item->name, item->id);
-    log_action(log_msg);
+    AuditFilter filter = {AUDIT_UPDATE_QTY, 7, 0, 0};
+    AuditQueryStats stats;
+    long passes = 0, records = 0, matched = 0;
+    started = now_us();
+    long long elapsed;
+    do {
+        query_audit_dir(BENCH_AUDIT_DIR, &filter, 0, NULL, 0, &stats);
+        records += stats.records;
+        matched += stats.matched;
+        passes++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCH_DECODE_MIN_US);
     
-    printf(GREEN "\n✅ Equipment added successfully. ID: %d\n" RESET, item->id);
-    wait_for_enter();
+    printf(CYAN "  %-8s" WHITE " %12.1f MB/s %10.1f M events/s  (%ld passes, %ld matches/pass)\n" RESET,
+           "decode", (double)binary_bytes * passes / elapsed, (double)records / elapsed,
+           passes, matched / passes);
+    
+    printf(BOLD WHITE "Queries over %ld blocks:\n" RESET, stats.blocks);
+    AuditFilter by_item = {-1, 7, 0, 0};
+    AuditFilter by_time = {-1, 0, window_us, 0};
+    benchmark_audit_query("item, scan", &by_item, 0);
+    benchmark_audit_query("item, index", &by_item, 1);
+    benchmark_audit_query("last 1%, scan", &by_time, 0);
+    benchmark_audit_query("last 1%, index", &by_time, 1);
+    
+    // Compress every segment the way the background thread does
+    audit_compressor.compress = 1;
+    audit_compressor.stop = 0;
+    started = now_us();
+    audit_maintain(&audit_compressor, INT_MAX);
+    long long compress_us = now_us() - started;
+    long long packed_bytes = audit_dir_bytes(BENCH_AUDIT_DIR, "zaudit") +
+                             audit_dir_bytes(BENCH_AUDIT_DIR, "zidx");
+    printf(BOLD WHITE "Compressed segments:\n" RESET);
+    printf(CYAN "  %-8s" WHITE " %12lld bytes %8.1f bytes/event  (%.1fx smaller, %.1f MB/s)\n" RESET,
+           "deflate", packed_bytes, (double)packed_bytes / iterations,
+           packed_bytes ? (double)binary_bytes / packed_bytes : 0.0,
+           compress_us ? (double)binary_bytes / compress_us : 0.0);
+    benchmark_audit_query("item, index", &by_item, 1);
+    benchmark_audit_query("last 1%, index", &by_time, 1);
+    benchmark_audit_query("all, scan", &by_item, 0);
+    
+    remove_audit_dir(BENCH_AUDIT_DIR);
+    remove(BENCH_AUDIT_TEXT_FILE);
 }
 
-void check_inventory(const char* item_name) {
-    display_banner();
-    printf(BOLD YELLOW "🔍 INVENTORY SEARCH RESULTS\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
+#define BENCH_REPLAY_DIR "bench_replay"
+#define BENCH_REPLAY_ITEMS 800
+#define BENCH_REPLAY_REQUESTS 400
+
+// Writes a mutation history with full rows, then rebuilds the inventory
+// from it repeatedly, whole and as of the midpoint, and checks the final
+// state against the quantities that were written
+void benchmark_replay(int iterations) {
+    remove_audit_dir(BENCH_REPLAY_DIR);
+    db_config.audit_compress = 0;
+    if (!audit_open(&audit_log, BENCH_REPLAY_DIR)) {
+        printf(RED "❌ Cannot create the benchmark log.\n" RESET);
+        return;
+    }
     
-    Equipment* item = hash_find(item_name);
-    if (item) {
-        display_equipment_details(item);
-    } else {
-        int found = 0;
-        for (int i = 0; i < item_count; i++) {
-            if (strcasestr(inventory[i].name, item_name)) {
-                display_equipment_details(&inventory[i]);
-                found = 1;
-                printf("\n");
-            }
-        }
-        if (!found) {
-            printf(RED "❌ No equipment found matching '%s'\n" RESET, item_name);
+    static int expected[BENCH_REPLAY_ITEMS + 1];
+    memset(expected, 0, sizeof(expected));
+    Equipment item = {0};
+    strcpy(item.description, "Replay benchmark row with a description of typical length");
+    strcpy(item.unit, "ea");
+    strcpy(item.location, "Warehouse B, rack 12");
+    SupplyRequest req = {0};
+    strcpy(req.requesting_unit, "1st Bn");
+    long long midpoint_us = 0;
+    
+    long long started = now_us();
+    for (int i = 0; i < iterations; i++) {
+        if (i == iterations / 2) midpoint_us = wall_clock_us();
+        item.id = i % BENCH_REPLAY_ITEMS + 1;
+        if (i < BENCH_REPLAY_ITEMS || i % 50 == 0) {
+            snprintf(item.name, sizeof(item.name), "Bench item %d", item.id);
+            item.quantity = i % 1000;
+            item.min_threshold = 10;
+            sprintf(item.checksum, "%04d", calculate_checksum(&item));
+            audit_add_equipment(&item);
+        } else if (i % 10 == 1) {
+            req.req_id = i / 10 % BENCH_REPLAY_REQUESTS + 1;
+            req.equipment_id = item.id;
+            req.requested_qty = 25;
+            req.priority = PRIORITY_NORMAL;
+            audit_supply_request(&req);
+            continue;
+        } else {
+            int old_qty = expected[item.id];
+            item.quantity = (old_qty + 7) % 1000;
+            sprintf(item.checksum, "%04d", calculate_checksum(&item));
+            audit_update_quantity(&item, old_qty);
         }
+        expected[item.id] = item.quantity;
     }
-    wait_for_enter();
-}
-
-void list_all_equipment(void) {
-    display_banner();
-    printf(BOLD YELLOW "📋 COMPLETE INVENTORY LISTING\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
+    long long write_us = now_us() - started;
+    audit_close(&audit_log);
+    audit_compressor_stop();
     
-    if (item_count == 0) {
-        printf(YELLOW "⚠️  No equipment in inventory.\n" RESET);
-        wait_for_enter();
-        return;
-    }
+    printf(BOLD WHITE "Replay workload: %d events over %d items, %.1f MB of log written in %.1f ms\n" RESET,
+           iterations, BENCH_REPLAY_ITEMS, audit_dir_bytes(BENCH_REPLAY_DIR, "audit") / 1048576.0,
+           write_us / 1000.0);
     
-    display_equipment_table_header();
+    const char* labels[2] = {"full log", "to midpoint"};
+    long long cutoffs[2] = {0, midpoint_us};
+    for (int run = 0; run < 2; run++) {
+        AuditQueryStats stats;
+        long passes = 0, records = 0;
+        long long elapsed;
+        started = now_us();
+        do {
+            replay_audit_log(BENCH_REPLAY_DIR, cutoffs[run], &stats);
+            records += stats.records;
+            passes++;
+            elapsed = now_us() - started;
+        } while (elapsed < BENCH_DECODE_MIN_US);
+        
+        printf(CYAN "  %-12s" WHITE " %10.2f ms/replay %8.2f M events/s  %8ld applied  %6ld of %ld blocks\n" RESET,
+               labels[run], elapsed / 1000.0 / passes, (double)records / elapsed,
+               replay_state.applied, stats.blocks_read, stats.blocks);
+    }
     
-    for (int i = 0; i < item_count; i++) {
-        display_equipment_row(&inventory[i]);
+    replay_audit_log(BENCH_REPLAY_DIR, 0, &(AuditQueryStats){0});
+    int mismatches = 0;
+    for (int id = 1; id <= BENCH_REPLAY_ITEMS && id <= iterations; id++) {
+        Equipment* rebuilt = find_by_id(id);
+        if (!rebuilt || rebuilt->quantity != expected[id]) mismatches++;
+    }
+    if (mismatches) {
+        printf(RED "❌ %d items differ from the written history.\n" RESET, mismatches);
+    } else {
+        printf(GREEN "✅ Rebuilt %d items and %d requests match the written history.\n" RESET,
+               item_count, request_count);
     }
     
-    display_equipment_table_footer(item_count);
-    wait_for_enter();
+    remove_audit_dir(BENCH_REPLAY_DIR);
 }
 
-void update_quantity(void) {
-    display_banner();
-    printf(BOLD YELLOW "📊 UPDATE EQUIPMENT QUANTITY\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    
-    int id = get_int_input("Equipment ID: ", 1, 999999);
-    Equipment* item = find_by_id(id);
-    
-    if (!item) {
-        printf(RED "❌ Equipment ID not found.\n" RESET);
-        wait_for_enter();
+#define BENCH_SNAPSHOT_DIR "bench_snapshots"
+#define BENCH_RESTORE_SNAPSHOTS 10
+
+// Writes a history with a snapshot every tenth of it, then compares a
+// restore from the nearest snapshot with a replay of the whole journal
+void benchmark_restore(int iterations) {
+    remove_audit_dir(BENCH_REPLAY_DIR);
+    remove_snapshot_dir(BENCH_SNAPSHOT_DIR);
+    strcpy(db_config.audit_dir, BENCH_REPLAY_DIR);
+    strcpy(db_config.snapshot_dir, BENCH_SNAPSHOT_DIR);
+    db_config.snapshot_keep = 0;
+    db_config.audit_compress = 0;
+    if (!audit_open(&audit_log, BENCH_REPLAY_DIR)) {
+        printf(RED "❌ Cannot create the benchmark log.\n" RESET);
         return;
     }
     
-    printf(CYAN "Current quantity: " WHITE "%d %s\n" RESET, item->quantity, item->unit);
-    int old_qty = item->quantity;
-    item->quantity = get_int_input("New quantity: ", 0, 999999);
+    item_count = request_count = 0;
+    next_item_id = next_request_id = 1;
+    int interval = iterations / BENCH_RESTORE_SNAPSHOTS > 0 ? iterations / BENCH_RESTORE_SNAPSHOTS : 1;
+    long long snapshot_us = 0;
+    for (int i = 0; i < iterations; i++) {
+        if (i % interval == 0) {
+            long long before = now_us();
+            take_snapshot(0);
+            snapshot_us += now_us() - before;
+        }
+        int id = i % BENCH_REPLAY_ITEMS + 1;
+        if (id > item_count) {
+            Equipment* item = &inventory[item_count++];
+            memset(item, 0, sizeof(*item));
+            item->id = next_item_id++;
+            snprintf(item->name, sizeof(item->name), "Bench item %d", item->id);
+            strcpy(item->unit, "ea");
+            item->quantity = i % 1000;
+            sprintf(item->checksum, "%04d", calculate_checksum(item));
+            audit_add_equipment(item);
+        } else {
+            Equipment* item = &inventory[id - 1];
+            int old_qty = item->quantity;
+            item->quantity = (old_qty + 7) % 1000;
+            sprintf(item->checksum, "%04d", calculate_checksum(item));
+            audit_update_quantity(item, old_qty);
+        }
+    }
+    audit_close(&audit_log);
+    audit_compressor_stop();
     
-    item->last_updated = time(NULL);
-    sprintf(item->checksum, "%04d", calculate_checksum(item));
+    static int expected[BENCH_REPLAY_ITEMS];
+    int expected_count = item_count;
+    for (int i = 0; i < item_count; i++) expected[i] = inventory[i].quantity;
     
-    if (use_database) {
-        update_equipment_in_db(item);
+    printf(BOLD WHITE "Restore workload: %d events, %d snapshots (%.2f ms each)\n" RESET, iterations,
+           BENCH_RESTORE_SNAPSHOTS, snapshot_us / 1000.0 / BENCH_RESTORE_SNAPSHOTS);
+    
+    AuditQueryStats stats;
+    long long from_us, started = now_us(), elapsed;
+    long passes = 0;
+    do {
+        restore_state(0, &from_us, &stats);
+        passes++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCH_DECODE_MIN_US);
+    printf(CYAN "  %-16s" WHITE " %10.2f ms/restore %8ld events replayed\n" RESET,
+           "snapshot + tail", elapsed / 1000.0 / passes, replay_state.applied);
+    
+    int mismatches = item_count != expected_count;
+    for (int i = 0; i < item_count && i < expected_count; i++) {
+        if (inventory[i].quantity != expected[i]) mismatches++;
     }
     
-    char log_msg[256];
-    sprintf(log_msg, "Updated %s quantity: %d -> %d", item->name, old_qty, item->quantity);
-    log_action(log_msg);
+    passes = 0;
+    started = now_us();
+    do {
+        replay_audit_log(BENCH_REPLAY_DIR, 0, &stats);
+        passes++;
+        elapsed = now_us() - started;
+    } while (elapsed < BENCH_DECODE_MIN_US);
+    printf(CYAN "  %-16s" WHITE " %10.2f ms/restore %8ld events replayed\n" RESET,
+           "whole journal", elapsed / 1000.0 / passes, replay_state.applied);
     
-    printf(GREEN "\n✅ Quantity updated successfully.\n" RESET);
-    wait_for_enter();
+    if (mismatches) {
+        printf(RED "❌ %d items differ from the state that was written.\n" RESET, mismatches);
+    } else {
+        printf(GREEN "✅ Restored state matches the state that was written.\n" RESET);
+    }
+    
+    remove_audit_dir(BENCH_REPLAY_DIR);
+    remove_snapshot_dir(BENCH_SNAPSHOT_DIR);
 }
 
-void request_supply(void) {
-    display_banner();
-    printf(BOLD YELLOW "📝 CREATE SUPPLY REQUEST\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    
-    if (request_count >= MAX_REQUESTS) {
-        printf(RED "❌ ERROR: Maximum request limit reached.\n" RESET);
-        wait_for_enter();
+#define BENCH_BACKUP_DIR "bench_backup"
+#define BENCH_BACKUP_MANIFEST BENCH_BACKUP_DIR "/bench.manifest"
+#define BENCH_BACKUP_DAYS 5
+#define BENCH_BACKUP_CHANGES (MAX_ITEMS / 100)
+
+// Deletes dir and everything below it
+void remove_tree(const char* dir) {
+    DIR* handle = opendir(dir);
+    if (handle) {
+        struct dirent* entry;
+        char path[512];
+        struct stat st;
+        while ((entry = readdir(handle)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) remove_tree(path);
+            else remove(path);
+        }
+        closedir(handle);
+    }
+    rmdir(dir);
+}
+
+// Checks a restored data file against the arrays it was backed up from
+static int restored_file_matches(const char* path, int count, const void* records, size_t record_size) {
+    size_t size;
+    const uint8_t* data = map_file(path, &size);
+    int ok = data && size == 2 * sizeof(int) + count * record_size && *(const int*)data == count &&
+             memcmp(data + 2 * sizeof(int), records, count * record_size) == 0;
+    if (data) munmap((void*)data, size);
+    return ok;
+}
+
+// Fills the store to capacity, then compares writing a backup inline with
+// forking a child to write it while the foreground keeps updating items.
+// A run of daily backups with 1% of the items changed in between follows,
+// and the last one is restored on one thread and on several.
+void benchmark_backup(int iterations) {
+    item_count = MAX_ITEMS;
+    next_item_id = MAX_ITEMS + 1;
+    for (int i = 0; i < MAX_ITEMS; i++) {
+        Equipment* item = &inventory[i];
+        memset(item, 0, sizeof(*item));
+        item->id = i + 1;
+        snprintf(item->name, sizeof(item->name), "Bench item %d", item->id);
+        strcpy(item->description, "Hot backup benchmark row");
+        item->quantity = i;
+    }
+    request_count = MAX_REQUESTS;
+    next_request_id = MAX_REQUESTS + 1;
+    for (int i = 0; i < MAX_REQUESTS; i++) {
+        memset(&requests[i], 0, sizeof(requests[i]));
+        requests[i].req_id = i + 1;
+        requests[i].equipment_id = i + 1;
+    }
+    remove_tree(BENCH_BACKUP_DIR);
+    if (mkdir(BENCH_BACKUP_DIR, 0755) != 0) {
+        printf(RED "❌ Cannot create %s.\n" RESET, BENCH_BACKUP_DIR);
         return;
     }
     
-    SupplyRequest* req = &requests[request_count];
-    req->req_id = next_request_id++;
-    
-    req->equipment_id = get_int_input("Equipment ID: ", 1, 999999);
-    
-    Equipment* item = find_by_id(req->equipment_id);
-    if (!item) {
-        printf(RED "❌ Equipment ID not found.\n" RESET);
-        wait_for_enter();
+    int* inline_us = malloc(iterations * sizeof(int));
+    int* stall_us = malloc(iterations * sizeof(int));
+    int* touch_us = malloc(iterations * sizeof(int));
+    if (!inline_us || !stall_us || !touch_us) {
+        free(inline_us);
+        free(stall_us);
+        free(touch_us);
         return;
     }
     
-    printf(GREEN "Requesting: " WHITE "%s\n" RESET, item->name);
-    req->requested_qty = get_int_input("Quantity needed: ", 1, 999999);
-    
-    get_string_input("Requesting unit: ", req->requesting_unit, MAX_UNIT_LEN);
-    
-    req->priority = get_int_input(
-        "Priority (1=Low, 2=Normal, 3=High, 4=Critical): ", 1, 4);
+    for (int i = 0; i < iterations; i++) {
+        long long before = now_us();
+        write_backup_manifest(BENCH_BACKUP_MANIFEST, 0);
+        inline_us[i] = (int)(now_us() - before);
+        
+        start_forked_copy(COPY_BACKUP, BENCH_BACKUP_MANIFEST, write_backup_manifest, 0);
+        stall_us[i] = (int)forked_copy.stall_us;
+        
+        // Operators keep working; each first write to a page copies it
+        before = now_us();
+        for (int j = 0; j < item_count; j++) inventory[j].quantity++;
+        touch_us[i] = (int)(now_us() - before);
+        
+        if (forked_copy.pid) waitpid(forked_copy.pid, NULL, 0);
+        forked_copy.pid = 0;
+    }
     
-    req->request_time = time(NULL);
-    req->status = REQ_PENDING;
+    qsort(inline_us, iterations, sizeof(int), compare_ints);
+    qsort(stall_us, iterations, sizeof(int), compare_ints);
+    qsort(touch_us, iterations, sizeof(int), compare_ints);
+    printf(BOLD WHITE "Backup of %d items and %d requests (%.0f KB), %d runs:\n" RESET, item_count,
+           request_count, (item_count * sizeof(Equipment) + request_count * sizeof(SupplyRequest)) / 1024.0,
+           iterations);
+    printf(CYAN "  %-24s" WHITE " p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n" RESET, "inline write",
+           sample_percentile(inline_us, iterations, 50), sample_percentile(inline_us, iterations, 99),
+           inline_us[iterations - 1] / 1000.0);
+    printf(CYAN "  %-24s" WHITE " p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n" RESET, "fork (foreground stall)",
+           sample_percentile(stall_us, iterations, 50), sample_percentile(stall_us, iterations, 99),
+           stall_us[iterations - 1] / 1000.0);
+    printf(CYAN "  %-24s" WHITE " p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n" RESET, "update pass during copy",
+           sample_percentile(touch_us, iterations, 50), sample_percentile(touch_us, iterations, 99),
+           touch_us[iterations - 1] / 1000.0);
+    free(inline_us);
+    free(stall_us);
+    free(touch_us);
     
-    if (use_database) {
-        int db_id = add_request_to_db(req);
-        if (db_id > 0) {
-            req->req_id = db_id;
-            if (db_id >= next_request_id) {
-                next_request_id = db_id + 1;
+    // Daily backups into a fresh store
+    remove_tree(BENCH_BACKUP_DIR);
+    mkdir(BENCH_BACKUP_DIR, 0755);
+    char manifest[192];
+    printf(BOLD WHITE "Daily backups, %d items changed per day:\n" RESET, BENCH_BACKUP_CHANGES);
+    srand(42);
+    for (int day = 0; day <= BENCH_BACKUP_DAYS; day++) {
+        if (day > 0) {
+            for (int c = 0; c < BENCH_BACKUP_CHANGES; c++) {
+                Equipment* item = &inventory[rand() % item_count];
+                item->quantity += 5;
+                item->last_updated = time(NULL) + day;
             }
         }
+        snprintf(manifest, sizeof(manifest), "%s/backup-day%d.manifest", BENCH_BACKUP_DIR, day);
+        long long before = now_us();
+        write_backup_manifest(manifest, 0);
+        long long took = now_us() - before;
+        printf(CYAN "  %-8s" WHITE " %4ld of %4ld chunks new  %10lld of %lld bytes written  %8.2f ms\n" RESET,
+               day ? "day" : "full", last_backup_stats.new_chunks, last_backup_stats.chunks,
+               last_backup_stats.new_bytes, last_backup_stats.total_bytes, took / 1000.0);
     }
     
-    request_count++;
-    
-    char log_msg[256];
-    sprintf(log_msg, "Supply request created: REQ-%d for equipment ID %d", 
-            req->req_id, req->equipment_id);
-    log_action(log_msg);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int counts[2] = {1, cores > 4 ? (cores < RESTORE_MAX_THREADS ? (int)cores : RESTORE_MAX_THREADS) : 4};
+    for (int run = 0; run < 2; run++) {
+        long long before = now_us();
+        long long bytes = restore_backup_files(manifest, BENCH_BACKUP_DIR "/restored-equipment.dat",
+                                               BENCH_BACKUP_DIR "/restored-requests.dat", counts[run], NULL);
+        long long took = now_us() - before;
+        int ok = bytes > 0 &&
+                 restored_file_matches(BENCH_BACKUP_DIR "/restored-equipment.dat", item_count, inventory,
+                                       sizeof(Equipment)) &&
+                 restored_file_matches(BENCH_BACKUP_DIR "/restored-requests.dat", request_count, requests,
+                                       sizeof(SupplyRequest));
+        printf(CYAN "  restore  " WHITE " %d thread%s  %8.2f ms  %s\n" RESET, counts[run],
+               counts[run] == 1 ? " " : "s", took / 1000.0, ok ? "verified" : RED "MISMATCH");
+    }
     
-    printf(GREEN "\n✅ Supply request submitted. Request ID: REQ-%d\n" RESET, req->req_id);
-    wait_for_enter();
+    item_count = request_count = 0;
+    remove_tree(BENCH_BACKUP_DIR);
 }
 
-void check_requests(void) {
-    display_banner();
-    printf(BOLD YELLOW "📑 SUPPLY REQUEST STATUS\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    
-    if (request_count == 0) {
-        printf(YELLOW "⚠️  No supply requests on file.\n" RESET);
-        wait_for_enter();
-        return;
+#define BENCH_LOAD_FILE "bench_equipment.dat"
+#define BENCH_LOAD_REQUEST_FILE "bench_requests.dat"
+
+// Counts the nodes in hash_table and checks each record is in its bucket
+int load_index_matches(void) {
+    int nodes = 0;
+    for (int b = 0; b < HASH_SIZE; b++) {
+        for (HashNode* node = hash_table[b]; node; node = node->next) nodes++;
     }
+    for (int i = 0; i < item_count; i++) {
+        HashNode* node = hash_table[hash_function(inventory[i].name)];
+        while (node && node->equipment != &inventory[i]) node = node->next;
+        if (!node) return 0;
+    }
+    return nodes == item_count;
+}
+
+// Loads one data file of up to MAX_ITEMS records (build with a larger
+// -DMAX_ITEMS for multi-million-item files) on 1, 2, 4 and, where there
+// are more, one thread per core. One record carries a bad checksum, which
+// every run has to report.
+void benchmark_load(int iterations) {
+    int count = iterations < MAX_ITEMS ? iterations : MAX_ITEMS;
+    strcpy(db_config.data_file, BENCH_LOAD_FILE);
+    strcpy(db_config.request_file, BENCH_LOAD_REQUEST_FILE);
+    item_count = request_count = 0;
+    next_item_id = next_request_id = 1;
+    for (int i = 0; i < count; i++) {
+        Equipment* item = &inventory[item_count++];
+        memset(item, 0, sizeof(*item));
+        item->id = next_item_id++;
+        snprintf(item->name, sizeof(item->name), "Bench item %d", item->id);
+        strcpy(item->unit, "ea");
+        item->quantity = i % 1000;
+        item->min_threshold = 10;
+        sprintf(item->checksum, "%04d", calculate_checksum(item));
+    }
+    if (count > 0) strcpy(inventory[count / 2].checksum, "bad");
+    FILE_ENGINE.flush();
     
-    printf(BOLD WHITE);
-    printf("┌──────────┬──────────┬──────────────┬─────────┬──────────────┬────────────┐\n");
-    printf("│ %-8s │ %-8s │ %-12s │ %-7s │ %-12s │ %-10s │\n",
-           "REQ-ID", "EQUIP-ID", "UNIT", "QTY", "PRIORITY", "STATUS");
-    printf("├──────────┼──────────┼──────────────┼─────────┼──────────────┼────────────┤\n");
-    printf(RESET);
-    
-    for (int i = 0; i < request_count; i++) {
-        SupplyRequest* req = &requests[i];
-        const char* status_color = (req->status == REQ_PENDING) ? YELLOW :
-                                  (req->status == REQ_APPROVED) ? GREEN :
-                                  (req->status == REQ_FULFILLED) ? BLUE : RED;
+    printf(BOLD WHITE "Load workload: %d items, %lld KB\n" RESET, count, file_size(BENCH_LOAD_FILE) / 1024);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int counts[4] = {1, 2, 4, cores > 4 ? (cores < LOAD_MAX_THREADS ? (int)cores : LOAD_MAX_THREADS) : 0};
+    double single_ms = 0;
+    for (int run = 0; run < 4 && counts[run]; run++) {
+        LoadStats stats;
+        long long started = now_us(), elapsed;
+        long passes = 0;
+        do {
+            load_equipment_file(BENCH_LOAD_FILE, counts[run], &stats);
+            passes++;
+            elapsed = now_us() - started;
+        } while (elapsed < BENCH_DECODE_MIN_US);
         
-        printf("│ %-8d │ %-8d │ %-12s │ %-7d │ %-12s │ %s%-10s%s │\n",
-               req->req_id, req->equipment_id, req->requesting_unit,
-               req->requested_qty, PRIORITY_NAMES[req->priority],
-               status_color, STATUS_NAMES[req->status], RESET);
+        double ms = elapsed / 1000.0 / passes;
+        if (run == 0) single_ms = ms;
+        int ok = item_count == count && stats.mismatches == (count > 0) && load_index_matches();
+        printf(CYAN "  %2d thread%s" WHITE " %10.3f ms/load %12.0f items/s  %5.2fx  %s\n" RESET, counts[run],
+               counts[run] == 1 ? " " : "s", ms, count / (ms / 1000.0), single_ms / ms,
+               ok ? "verified" : RED "MISMATCH");
     }
     
-    printf("└──────────┴──────────┴──────────────┴─────────┴──────────────┴────────────┘\n");
-    printf(BOLD CYAN "Total Supply Requests: %d\n" RESET, request_count);
-    wait_for_enter();
+    hash_clear();
+    item_count = 0;
+    remove(BENCH_LOAD_FILE);
+    remove(BENCH_LOAD_REQUEST_FILE);
 }
 
-void low_stock_alert(void) {
-    display_banner();
-    printf(BOLD RED "🚨 LOW STOCK ALERT\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    printf(BOLD WHITE "Equipment requiring immediate attention:\n\n" RESET);
-    
-    int alerts = 0;
+#define BENCH_RING_LOG "bench_ring.log"
+#define BENCH_RING_DIR "bench_ring_audit"
+#define BENCH_RING_MAX_THREADS 4
+#define BENCH_RING_BURST (EVENT_RING_SLOTS / 4)
+
+typedef struct {
+    pthread_t thread;
+    int first_id;
+    int events;
+    int burst;                  // Pause after this many events (0 = never)
+    long long elapsed_us;       // Time spent inside the logging calls
+} RingProducer;
+
+// One producer thread: mostly audit updates with an action log line
+// every eighth event, like a busy import. Bursts that fit in the ring
+// time the producer's side alone; the pauses let the writer catch up.
+void* ring_producer_main(void* arg) {
+    RingProducer* producer = arg;
+    Equipment item = {0};
+    strcpy(item.name, "Bench item");
+    char message[MAX_LOG_MSG_LEN];
+    struct timespec pause = {0, 2000000};
     
-    for (int i = 0; i < item_count; i++) {
-        if (get_stock_status(&inventory[i]) == STATUS_LOW) {
-            printf(BOLD RED "🚨 CRITICAL: " WHITE "%s (ID: %d)\n" RESET, 
-                   inventory[i].name, inventory[i].id);
-            printf(CYAN "    Current: " WHITE "%d" CYAN ", Minimum: " WHITE "%d\n" RESET, 
-                   inventory[i].quantity, inventory[i].min_threshold);
-            printf(CYAN "    Location: " WHITE "%s\n\n" RESET, inventory[i].location);
-            alerts++;
+    long long started = now_us();
+    for (int i = 0; i < producer->events; i++) {
+        item.id = producer->first_id + i % 500;
+        item.quantity = i % 1000;
+        if (i % 8 == 0) {
+            snprintf(message, sizeof(message), "Imported batch %d", i / 8);
+            log_event(LOG_INFO, message);
+        } else {
+            audit_update_quantity(&item, item.quantity + 1);
+        }
+        if (producer->burst && (i + 1) % producer->burst == 0) {
+            producer->elapsed_us += now_us() - started;
+            nanosleep(&pause, NULL);
+            started = now_us();
         }
     }
-    
-    if (alerts == 0) {
-        printf(GREEN "✅ All equipment levels are adequate.\n" RESET);
-    } else {
-        printf(BOLD RED "⚠️  Total items requiring resupply: %d\n" RESET, alerts);
+    producer->elapsed_us += now_us() - started;
+    return NULL;
+}
+
+// Runs `threads` producers through the ring and reports their cost per
+// event, how often they found it full and the writer's batch size
+void benchmark_ring_run(const char* label, int threads, int events, int burst) {
+    if (!event_ring_start()) {
+        printf(RED "❌ Cannot start the event ring.\n" RESET);
+        return;
+    }
+    RingProducer producers[BENCH_RING_MAX_THREADS];
+    long long started = now_us();
+    for (int t = 0; t < threads; t++) {
+        producers[t] = (RingProducer){0, 1 + t * 500, events / threads, burst, 0};
+        pthread_create(&producers[t].thread, NULL, ring_producer_main, &producers[t]);
+    }
+    long long producer_us = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(producers[t].thread, NULL);
+        producer_us += producers[t].elapsed_us;
     }
+    long overflows = atomic_load(&event_ring.overflows);
+    event_ring_stop();
+    long long elapsed_us = now_us() - started;
     
-    wait_for_enter();
+    events = events / threads * threads;
+    printf(CYAN "  %-14s" WHITE " %8.1f ns/event  %7.2f M events/s written  %6ld full  %5.0f events/batch\n" RESET,
+           label, producer_us * 1000.0 / events, (double)events / elapsed_us, overflows,
+           event_ring.batches ? (double)event_ring.consumed / event_ring.batches : 0.0);
 }
 
-void export_report(void) {
-    display_banner();
-    printf(BOLD YELLOW "📄 EXPORT INVENTORY REPORT\n" RESET);
-    printf("════════════════════════════════════════════════════════════════════════════════\n");
-    
-    FILE* report = fopen("inventory_report.txt", "w");
-    if (!report) {
-        printf(RED "❌ Error creating report file.\n" RESET);
-        wait_for_enter();
+// Producer-side cost per event, writing directly and through the ring
+// with 1, 2 and 4 producer threads, then sustained ring throughput
+void benchmark_ring(int iterations) {
+    remove(BENCH_RING_LOG);
+    remove_audit_dir(BENCH_RING_DIR);
+    if (!logger_open(&action_logger, BENCH_RING_LOG, FSYNC_NONE, DEFAULT_LOG_FLUSH_MS) ||
+        !audit_open(&audit_log, BENCH_RING_DIR)) {
+        printf(RED "❌ Cannot create benchmark logs.\n" RESET);
+        logger_close(&action_logger);
         return;
     }
+    printf(BOLD WHITE "Event ring workload: %d events, %d slots, bursts of %d\n" RESET,
+           iterations, EVENT_RING_SLOTS, BENCH_RING_BURST);
     
-    time_t now = time(NULL);
-    fprintf(report, "TACTICAL SUPPLY INVENTORY REPORT\n");
-    fprintf(report, "Generated: %s", ctime(&now));
-    fprintf(report, "Data Source: %s\n", use_database ? "PostgreSQL Database" : "Local Files");
-    fprintf(report, "================================\n\n");
-    
-    fprintf(report, "INVENTORY SUMMARY:\n");
-    fprintf(report, "Total Items: %d\n", item_count);
+    RingProducer direct = {0, 1, iterations, BENCH_RING_BURST, 0};
+    ring_producer_main(&direct);
+    printf(CYAN "  %-14s" WHITE " %8.1f ns/event  (caller encodes and writes)\n" RESET,
+           "direct", direct.elapsed_us * 1000.0 / iterations);
     
-    int low_stock = 0;
-    for (int i = 0; i < item_count; i++) {
-        if (get_stock_status(&inventory[i]) == STATUS_LOW) {
-            low_stock++;
-        }
+    char label[32];
+    for (int threads = 1; threads <= BENCH_RING_MAX_THREADS; threads *= 2) {
+        snprintf(label, sizeof(label), "ring x%d", threads);
+        benchmark_ring_run(label, threads, iterations, BENCH_RING_BURST / threads);
     }
-    fprintf(report, "Items requiring resupply: %d\n\n", low_stock);
+    benchmark_ring_run("ring sustained", 1, iterations, 0);
     
-    fprintf(report, "DETAILED INVENTORY:\n");
-    for (int i = 0; i < item_count; i++) {
-        Equipment* item = &inventory[i];
-        fprintf(report, "ID: %d | %s | Qty: %d %s | Location: %s | Status: %s | Class: %s\n",
-                item->id, item->name, item->quantity, item->unit, 
-                item->location, STOCK_STATUS_NAMES[get_stock_status(item)],
-                CLASS_NAMES[item->classification]);
+    logger_close(&action_logger);
+    audit_close(&audit_log);
+    audit_compressor_stop();
+    remove(BENCH_RING_LOG);
+    remove_audit_dir(BENCH_RING_DIR);
+}
+
+int run_benchmark(const char* name, int iterations) {
+    if (strcmp(name, "updates") == 0) {
+        benchmark_updates(iterations);
+        return 1;
+    }
+    if (strcmp(name, "engines") == 0) {
+        benchmark_engines(iterations);
+        return 1;
+    }
+    if (strcmp(name, "logger") == 0) {
+        benchmark_logger(iterations);
+        return 1;
+    }
+    if (strcmp(name, "audit") == 0) {
+        benchmark_audit(iterations);
+        return 1;
+    }
+    if (strcmp(name, "ring") == 0) {
+        benchmark_ring(iterations);
+        return 1;
+    }
+    if (strcmp(name, "replay") == 0) {
+        benchmark_replay(iterations);
+        return 1;
+    }
+    if (strcmp(name, "restore") == 0) {
+        benchmark_restore(iterations);
+        return 1;
+    }
+    if (strcmp(name, "backup") == 0) {
+        benchmark_backup(iterations);
+        return 1;
+    }
+    if (strcmp(name, "load") == 0) {
+        benchmark_load(iterations);
+        return 1;
     }
     
-    fclose(report);
-    printf(GREEN "✅ Report exported to 'inventory_report.txt'\n" RESET);
-    log_action("Inventory report exported");
-    wait_for_enter();
+    printf(RED "❌ Unknown benchmark '%s'. Available: updates, engines, logger, audit, ring, replay, "
+               "restore, backup, load\n" RESET, name);
+    return 0;
 }
 
-int main(void) {
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "--audit") == 0) {
+        return run_audit_decoder(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--replay") == 0) {
+        return run_replay(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--restore") == 0) {
+        return run_restore(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--restore-backup") == 0) {
+        return run_restore_backup(argc - 2, argv + 2);
+    }
+    
     printf(GREEN "🔄 Initializing Tactical Supply Management System...\n" RESET);
     
     memset(hash_table, 0, sizeof(hash_table));
     
-    use_database = connect_database();
-    load_data();
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        int iterations = argc >= 4 ? atoi(argv[3]) : 1000;
+        int ok = run_benchmark(argv[2], iterations > 0 ? iterations : 1000);
+        hash_clear();
+        return ok ? 0 : 1;
+    }
+    
+    startup_started_us = startup_mark_us = now_us();
+    open_storage();
+    if (db_config.log_ring) event_ring_start();
+    
+    // The first timer tick takes a snapshot unless a recent one exists
+    long long* snapshot_times;
+    int snapshots = list_snapshots(db_config.snapshot_dir, &snapshot_times);
+    if (snapshots > 0) last_snapshot = (time_t)(snapshot_times[snapshots - 1] / 1000000);
+    free(snapshot_times);
+    last_resync = time(NULL);
     
     printf(GREEN "🎯 System ready. Loaded %d equipment items and %d requests.\n" RESET, 
            item_count, request_count);
-    sleep(2);
+    print_startup_timeline();
+    
+    audit_startup((now_us() - startup_started_us) / 1000);
     
     int choice;
     char search_term[MAX_NAME_LEN];
     
     while (1) {
         display_menu();
-        choice = get_int_input("", 1, 9);
+        ui_at_menu = 1;
+        choice = get_int_input("", 1, 12);
+        ui_at_menu = 0;
         
         switch (choice) {
             case 1: add_equipment(); break;
@@ -941,29 +8362,10 @@ int main(void) {
             case 6: check_requests(); break;
             case 7: low_stock_alert(); break;
             case 8: export_report(); break;
-            case 9:
-                display_banner();
-                printf(BOLD YELLOW "🔄 Shutting down system...\n" RESET);
-                save_data();
-                printf(GREEN "💾 Data saved successfully.\n" RESET);
-                log_action("System shutdown");
-                
-                if (db_conn) {
-                    PQfinish(db_conn);
-                }
-                
-                for (int i = 0; i < HASH_SIZE; i++) {
-                    HashNode* current = hash_table[i];
-                    while (current) {
-                        HashNode* temp = current;
-                        current = current->next;
-                        free(temp);
-                    }
-                }
-                
-                printf(BOLD GREEN "🛡️  Tactical Supply Management System offline.\n" RESET);
-                printf(BOLD WHITE "✅ All systems secured. Mission complete.\n" RESET);
-                exit(0);
+            case 10: resync_database(); break;
+            case 11: query_statistics(); break;
+            case 12: backup_inventory(); break;
+            case 9: shutdown_system(); break;
         }
     }
     